@@ -0,0 +1,246 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_AST_H
+#define PYTHON_INTERPRETER_AST_H
+
+#include "Value.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compact syntax tree produced by Lowering. Operators are resolved to enums,
+// names and literals are extracted once, and single-child grammar chains
+// (test -> or_test -> ... -> atom) are collapsed into their only child.
+namespace ast {
+
+enum class BinaryOp { Add, Sub, Mul, Div, FloorDiv, Mod };
+enum class CompareOp { Lt, Gt, Le, Ge, Eq, Ne };
+enum class LogicalOp { And, Or };
+enum class UnaryOp { Neg, Not };
+
+// Functions built into the language; calls naming one are resolved to it
+// when lowering, ahead of any user function of the same name
+enum class Builtin { None, Print, Int, Float, Str, Bool };
+
+inline Builtin builtinNamed(const std::string& name) {
+    if (name == "print") return Builtin::Print;
+    if (name == "int") return Builtin::Int;
+    if (name == "float") return Builtin::Float;
+    if (name == "str") return Builtin::Str;
+    if (name == "bool") return Builtin::Bool;
+    return Builtin::None;
+}
+
+// Native implementations of the one-argument builtins, indexed by Builtin
+using Conversion = Value (*)(const Value&);
+
+inline Value applyConversion(Builtin builtin, const Value& arg) {
+    static const Conversion conversions[] = {
+        nullptr,
+        nullptr,
+        [](const Value& v) { return Value(v.toInt()); },
+        [](const Value& v) { return Value(v.toFloat()); },
+        [](const Value& v) { return Value(v.toString()); },
+        [](const Value& v) { return Value(v.toBool()); },
+    };
+    return conversions[static_cast<int>(builtin)](arg);
+}
+
+inline Value applyBinary(BinaryOp op, Value left, const Value& right) {
+    switch (op) {
+        case BinaryOp::Add: return std::move(left) + right;
+        case BinaryOp::Sub: return std::move(left) - right;
+        case BinaryOp::Mul: return std::move(left) * right;
+        case BinaryOp::Div: return left / right;
+        case BinaryOp::FloorDiv: return left.floordiv(right);
+        case BinaryOp::Mod: return left % right;
+    }
+    return Value();
+}
+
+inline bool applyCompare(CompareOp op, const Value& left, const Value& right) {
+    switch (op) {
+        case CompareOp::Lt: return left < right;
+        case CompareOp::Gt: return left > right;
+        case CompareOp::Le: return left <= right;
+        case CompareOp::Ge: return left >= right;
+        case CompareOp::Eq: return left == right;
+        case CompareOp::Ne: return left != right;
+    }
+    return false;
+}
+
+// Expressions
+struct Expr {
+    enum class Kind { Constant, Name, Unary, Binary, Compare, Logical, Call, Tuple, FString };
+    
+    const Kind kind;
+    
+    explicit Expr(Kind k) : kind(k) {}
+    virtual ~Expr() = default;
+};
+
+using ExprPtr = std::unique_ptr<Expr>;
+
+struct ConstantExpr : Expr {
+    Value value;
+    
+    explicit ConstantExpr(Value v) : Expr(Kind::Constant), value(std::move(v)) {}
+};
+
+struct NameExpr : Expr {
+    std::string name;
+    
+    explicit NameExpr(std::string n) : Expr(Kind::Name), name(std::move(n)) {}
+};
+
+struct UnaryExpr : Expr {
+    UnaryOp op;
+    ExprPtr operand;
+    
+    UnaryExpr(UnaryOp o, ExprPtr e) : Expr(Kind::Unary), op(o), operand(std::move(e)) {}
+};
+
+struct BinaryExpr : Expr {
+    BinaryOp op;
+    ExprPtr left;
+    ExprPtr right;
+    
+    BinaryExpr(BinaryOp o, ExprPtr l, ExprPtr r)
+        : Expr(Kind::Binary), op(o), left(std::move(l)), right(std::move(r)) {}
+};
+
+// a < b <= c: operands.size() == ops.size() + 1
+struct CompareExpr : Expr {
+    std::vector<ExprPtr> operands;
+    std::vector<CompareOp> ops;
+    
+    CompareExpr() : Expr(Kind::Compare) {}
+};
+
+struct LogicalExpr : Expr {
+    LogicalOp op;
+    std::vector<ExprPtr> operands;
+    
+    explicit LogicalExpr(LogicalOp o) : Expr(Kind::Logical), op(o) {}
+};
+
+// A call argument; keyword is empty for positional arguments
+struct Argument {
+    std::string keyword;
+    ExprPtr value;
+};
+
+struct CallExpr : Expr {
+    std::string callee;
+    Builtin builtin = Builtin::None;
+    int function = -1;  // function slot of the callee unless it is a builtin
+    ExprPtr atom;       // the callee atom, evaluated when no function of that name exists
+    std::vector<Argument> args;
+    
+    CallExpr() : Expr(Kind::Call) {}
+};
+
+struct TupleExpr : Expr {
+    std::vector<ExprPtr> elements;
+    
+    TupleExpr() : Expr(Kind::Tuple) {}
+};
+
+// Formatted string split into literal text and placeholder expressions
+struct FStringExpr : Expr {
+    struct Part {
+        std::string literal;
+        ExprPtr expr;   // null for literal parts
+    };
+    std::vector<Part> parts;
+    
+    FStringExpr() : Expr(Kind::FString) {}
+};
+
+// Statements
+struct Stmt {
+    enum class Kind { Expr, Assign, AugAssign, If, While, Break, Continue, Return, FunctionDef };
+    
+    const Kind kind;
+    
+    explicit Stmt(Kind k) : kind(k) {}
+    virtual ~Stmt() = default;
+};
+
+using StmtPtr = std::unique_ptr<Stmt>;
+using Block = std::vector<StmtPtr>;
+
+struct ExprStmt : Stmt {
+    ExprPtr expr;
+    
+    explicit ExprStmt(ExprPtr e) : Stmt(Kind::Expr), expr(std::move(e)) {}
+};
+
+// t1 = t2 = ... = value, where every target list holds one name per
+// comma-separated target ("" for targets that are not plain names)
+struct AssignStmt : Stmt {
+    std::vector<std::vector<std::string>> targets;
+    ExprPtr value;
+    
+    AssignStmt() : Stmt(Kind::Assign) {}
+};
+
+struct AugAssignStmt : Stmt {
+    std::vector<std::string> targets;
+    BinaryOp op;
+    ExprPtr value;
+    
+    AugAssignStmt() : Stmt(Kind::AugAssign) {}
+};
+
+// if/elif chain: conditions[i] guards branches[i], orelse runs otherwise
+struct IfStmt : Stmt {
+    std::vector<ExprPtr> conditions;
+    std::vector<Block> branches;
+    Block orelse;
+    
+    IfStmt() : Stmt(Kind::If) {}
+};
+
+struct WhileStmt : Stmt {
+    ExprPtr condition;
+    Block body;
+    
+    WhileStmt() : Stmt(Kind::While) {}
+};
+
+struct BreakStmt : Stmt {
+    BreakStmt() : Stmt(Kind::Break) {}
+};
+
+struct ContinueStmt : Stmt {
+    ContinueStmt() : Stmt(Kind::Continue) {}
+};
+
+struct ReturnStmt : Stmt {
+    ExprPtr value;   // null for a bare return
+    
+    ReturnStmt() : Stmt(Kind::Return) {}
+};
+
+// def name(params): body; defaults belong to the trailing parameters
+struct FunctionDefStmt : Stmt {
+    std::string name;
+    int function = -1;  // function slot the definition binds
+    std::vector<std::string> params;
+    std::vector<ExprPtr> defaults;
+    Block body;
+    
+    FunctionDefStmt() : Stmt(Kind::FunctionDef) {}
+};
+
+// Every name that is defined or called as a function gets a slot, so the
+// engines find user functions by index instead of by name
+struct Program {
+    Block body;
+    std::vector<std::string> functionNames;     // by function slot
+};
+
+} // namespace ast
+
+#endif//PYTHON_INTERPRETER_AST_H
@@ -0,0 +1,102 @@
+#include "Bytecode.h"
+
+namespace bytecode {
+
+namespace {
+
+// Arithmetic and comparisons, generic or quickened, read both b and c
+bool binary(Op op) {
+    return (op >= Op::Add && op <= Op::Ne) || (op >= Op::AddInt && op <= Op::NeStr);
+}
+
+} // namespace
+
+void operands(const Module& module, const Instr& in, std::vector<int>& reads, std::vector<int>& writes) {
+    reads.clear();
+    writes.clear();
+    auto range = [&](int first, size_t count) {
+        for (size_t i = 0; i < count; i++) reads.push_back(first + i);
+    };
+    switch (in.op) {
+        case Op::LoadConst:
+        case Op::LoadGlobal:
+            writes.push_back(in.a);
+            break;
+        case Op::StoreGlobal:
+        case Op::AugGlobal:
+            reads.push_back(in.b);
+            break;
+        case Op::UnpackStore:
+            reads.push_back(in.b);
+            for (auto& target : module.targetLists[in.a]) {
+                if (target.kind == Target::Kind::Local) writes.push_back(target.index);
+            }
+            break;
+        case Op::JumpIfFalse:
+        case Op::JumpIfTrue:
+            reads.push_back(in.b);
+            break;
+        case Op::BuildTuple:
+        case Op::Format:
+        case Op::Print:
+            range(in.b, in.c);
+            writes.push_back(in.a);
+            break;
+        case Op::Call:
+        case Op::TailCall: {
+            auto& site = module.callSites[in.b];
+            range(site.firstArg, site.keywords.size());
+            writes.push_back(in.a);
+            break;
+        }
+        case Op::MakeFunction:
+            range(in.b, module.functions[in.a].defaultCount);
+            break;
+        case Op::Return:
+            reads.push_back(in.a);
+            break;
+        case Op::Jump:
+        case Op::Halt:
+            break;
+        default:
+            // Copies, arithmetic, comparisons, Not, Neg and Convert
+            reads.push_back(in.b);
+            if (binary(in.op)) reads.push_back(in.c);
+            writes.push_back(in.a);
+            break;
+    }
+}
+
+void successors(const Instr& in, size_t at, std::vector<size_t>& out) {
+    out.clear();
+    switch (in.op) {
+        case Op::Jump:
+        case Op::Loop:
+            out.push_back(in.a);
+            break;
+        case Op::JumpIfFalse:
+        case Op::JumpIfTrue:
+        case Op::JumpIfFalseI64:
+        case Op::JumpIfTrueI64:
+        case Op::JumpIfFalseF64:
+        case Op::JumpIfTrueF64:
+            out.push_back(at + 1);
+            out.push_back(in.a);
+            break;
+        case Op::Call:
+            out.push_back(at + 1);
+            out.push_back(in.c);
+            break;
+        case Op::Return:
+        case Op::ReturnI64:
+        case Op::ReturnF64:
+        case Op::Halt:
+            break;
+        default:
+            out.push_back(at + 1);
+            break;
+    }
+}
+
+
+} // namespace bytecode
@@ -0,0 +1,211 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_BYTECODE_H
+#define PYTHON_INTERPRETER_BYTECODE_H
+
+#include "Ast.h"
+#include "Value.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Register-machine instruction stream for the VM. Every code object owns a
+// window of numRegs registers: a function's parameters and locals come
+// first, in slots resolved at compile time, followed by its temporaries.
+// Instructions name their operands directly (Add r3, r1, r2). Globals live
+// in one table indexed by the slots the compiler assigned; other operands
+// index the module's pools or are absolute jump targets.
+//
+//   LoadConst        r[a] = constants[b]
+//   LoadGlobal       r[a] = globals[b]
+//   StoreGlobal      globals[a] = r[b]; the register is moved from unless c is set
+//   AugGlobal        globals[a] = globals[a] (BinaryOp c) r[b]
+//   UnpackStore      store the elements of the tuple r[b] into targetLists[a];
+//                    unless c is set the tuple is moved from
+//   Copy             r[a] = r[b]
+//   Move             r[a] = move(r[b])
+//   Add ... Mod      r[a] = r[b] op r[c], in place when a == b
+//   Lt ... Ne        r[a] = r[b] op r[c]
+//   Not, Neg         r[a] = op r[b]
+//   Jump             jump to a
+//   JumpIfFalse      jump to a if r[b] is false
+//   JumpIfTrue       jump to a if r[b] is true
+//   BuildTuple       r[a] = (r[b], ..., r[b+c-1])
+//   Format           r[a] = the text of r[b], ..., r[b+c-1] concatenated
+//   Print            print r[b], ..., r[b+c-1]; r[a] = None
+//   Convert          r[a] = int/float/str/bool(r[b]) for ast::Builtin c
+//   Call             r[a] = call callSites[b]; while its function slot is
+//                    undefined, fall through to the atom code ending at c
+//   TailCall         like Call, but the callee takes over the current frame and
+//                    returns straight to this frame's caller
+//   MakeFunction     define functions[a] in its function slot with defaults
+//                    r[b], r[b+1], ...
+//   Return           leave the frame with r[a]
+//   Halt             stop the program
+//
+// The generic arithmetic and comparison opcodes quicken themselves: the first
+// time they see two operands of the same INT, FLOAT or STRING type they are
+// rewritten in place into a specialized opcode such as AddInt or LtStr. The
+// specialized form checks that guard and deoptimizes back to the generic
+// opcode when it fails; after kMaxDeopts failures a site stays generic.
+//
+// A function body may also have a specialized copy, built by the Specializer
+// with the same layout, in which the registers proven to hold only ints or
+// only floats are kept unboxed in u[], a second file of int64_t/double slots
+// parallel to the registers:
+//
+//   LoadI64, LoadF64     u[a] = intConstants[b] or floatConstants[b]
+//   CopyRaw              u[a] = u[b]
+//   BoxI64, BoxF64       r[a] = u[b]
+//   AddI64 ... ModI64    u[a] = u[b] op u[c]; the Boxed forms store into r[a]
+//   AddF64 ... DivF64    likewise on doubles
+//   LtI64 ... NeF64      r[a] = u[b] op u[c]
+//   JumpIfFalseI64 ...   jump to a if u[b] is zero, or nonzero
+//   ReturnI64, ReturnF64 leave the frame with u[a]
+//   Loop                 jump back to a; counts toward compiling the body
+//
+// An int result outside int64 or an int division by zero deoptimizes the
+// frame: its unboxed registers are boxed and it carries on at the same
+// instruction of the generic body.
+namespace bytecode {
+
+#define BYTECODE_OPS(X) \
+    X(LoadConst) X(LoadGlobal) X(StoreGlobal) X(AugGlobal) X(UnpackStore) X(Copy) X(Move) \
+    X(Add) X(Sub) X(Mul) X(Div) X(FloorDiv) X(Mod) \
+    X(Lt) X(Gt) X(Le) X(Ge) X(Eq) X(Ne) \
+    X(Not) X(Neg) X(Jump) X(JumpIfFalse) X(JumpIfTrue) \
+    X(BuildTuple) X(Format) X(Print) X(Convert) X(Call) X(TailCall) X(MakeFunction) X(Return) X(Halt) \
+    X(AddInt) X(AddFloat) X(AddStr) X(SubInt) X(SubFloat) X(MulInt) X(MulFloat) \
+    X(FloorDivInt) X(ModInt) \
+    X(LtInt) X(LtFloat) X(LtStr) X(GtInt) X(GtFloat) X(GtStr) \
+    X(LeInt) X(LeFloat) X(LeStr) X(GeInt) X(GeFloat) X(GeStr) \
+    X(EqInt) X(EqFloat) X(EqStr) X(NeInt) X(NeFloat) X(NeStr) \
+    X(LoadI64) X(LoadF64) X(CopyRaw) X(BoxI64) X(BoxF64) \
+    X(AddI64) X(SubI64) X(MulI64) X(FloorDivI64) X(ModI64) \
+    X(AddI64Boxed) X(SubI64Boxed) X(MulI64Boxed) X(FloorDivI64Boxed) X(ModI64Boxed) \
+    X(AddF64) X(SubF64) X(MulF64) X(DivF64) \
+    X(AddF64Boxed) X(SubF64Boxed) X(MulF64Boxed) X(DivF64Boxed) \
+    X(LtI64) X(GtI64) X(LeI64) X(GeI64) X(EqI64) X(NeI64) \
+    X(LtF64) X(GtF64) X(LeF64) X(GeF64) X(EqF64) X(NeF64) \
+    X(JumpIfFalseI64) X(JumpIfTrueI64) X(JumpIfFalseF64) X(JumpIfTrueF64) \
+    X(ReturnI64) X(ReturnF64) X(Loop)
+
+enum class Op : uint8_t {
+#define BYTECODE_OP_ENUM(name) name,
+    BYTECODE_OPS(BYTECODE_OP_ENUM)
+#undef BYTECODE_OP_ENUM
+};
+
+struct Instr {
+    static constexpr uint8_t kMaxDeopts = 4;
+    
+    Op op;
+    uint8_t deopts = 0;     // guard failures of quickened forms at this site
+    int32_t a = 0;
+    int32_t b = 0;
+    int32_t c = 0;
+};
+
+// The binary and comparison opcodes are laid out in ast enum order
+inline Op binaryOp(ast::BinaryOp op) {
+    return static_cast<Op>(static_cast<int>(Op::Add) + static_cast<int>(op));
+}
+
+inline Op compareOp(ast::CompareOp op) {
+    return static_cast<Op>(static_cast<int>(Op::Lt) + static_cast<int>(op));
+}
+
+// Where an assignment stores: a register of the current frame or a global
+struct Target {
+    enum class Kind : uint8_t { None, Local, Global };
+    
+    Kind kind;
+    int index;
+};
+
+struct CodeObject {
+    std::vector<Instr> code;
+    int numRegs = 0;
+};
+
+struct FunctionCode;
+
+// Arguments of one call expression, evaluated into consecutive registers
+// from firstArg; keywords[i] is a name index or -1 for positional arguments.
+// The callee's register window starts at firstArg, so positional arguments
+// are already in their parameter slots when the call begins.
+struct CallSite {
+    int function;       // function slot of the callee
+    int firstArg;
+    std::vector<int> keywords;
+    
+    // How the arguments bind to the parameters of the callee last called
+    // from here; recomputed when the site reaches a different function
+    const FunctionCode* boundCallee = nullptr;
+    bool inPlace = false;           // every argument is already in its slot
+    std::vector<int> argSlots;      // parameter slot of each argument, -1 if none
+    std::vector<int> unboundSlots;  // parameters no argument binds
+};
+
+// How a register of a specialized body holds its value
+enum class RegKind : uint8_t { Boxed, Int, Float };
+
+// Instruction i of body corresponds to instruction i of the generic body. A
+// register may hold boxed and unboxed values at different points, so the
+// instructions that can deoptimize list the registers unboxed there. A call
+// runs the body when every unboxed parameter fits; a function whose frames
+// keep deoptimizing goes back to the generic body for good. With the JIT on,
+// a body that gets hot is compiled to native code that runs from its start or
+// a loop header and returns the index of the instruction to resume at.
+struct Specialization {
+    static constexpr int kMaxDeopts = 4;
+    
+    using NativeCode = int (*)(void* unboxed, Value* registers, int entry);
+    
+    struct Slot {
+        int reg;
+        RegKind kind;
+    };
+    
+    CodeObject body;
+    std::vector<RegKind> params;            // how each parameter is held on entry
+    std::vector<std::vector<Slot>> exits;   // by instruction
+    int deopts = 0;
+    int hotness = 0;                        // calls and back edges so far
+    bool compiled = false;                  // the JIT has been asked
+    NativeCode native = nullptr;
+};
+
+// Parameters occupy registers 0 .. params.size() - 1 of the body, the other
+// locals follow up to numLocals
+struct FunctionCode {
+    int function;       // function slot the definition binds
+    std::vector<int> params;
+    int numLocals;
+    size_t defaultCount;
+    CodeObject body;
+    std::unique_ptr<Specialization> specialized;    // null if nothing is unboxed
+};
+
+struct Module {
+    std::vector<Value> constants;
+    std::vector<int64_t> intConstants;      // unboxed constants of specialized bodies
+    std::vector<double> floatConstants;
+    std::vector<std::string> names;
+    std::vector<std::string> globalNames;       // by global slot
+    std::vector<std::vector<Target>> targetLists;
+    std::vector<CallSite> callSites;
+    std::vector<FunctionCode> functions;
+    std::vector<std::string> functionNames;     // by function slot
+    std::vector<char> pureFunctions;            // by function slot; see Compiler
+    CodeObject main;
+};
+
+// The registers a generic or quickened instruction reads and writes, and the
+// instructions that can run after the one at index at
+void operands(const Module& module, const Instr& in, std::vector<int>& reads, std::vector<int>& writes);
+void successors(const Instr& in, size_t at, std::vector<size_t>& out);
+
+} // namespace bytecode
+
+#endif//PYTHON_INTERPRETER_BYTECODE_H
@@ -0,0 +1,1013 @@
+#include "Compiler.h"
+#include "MemoCache.h"
+#include <algorithm>
+#include <functional>
+
+using namespace ast;
+using bytecode::Op;
+using bytecode::Target;
+
+namespace {
+
+// Calls f on each direct subexpression
+template <class F>
+void forEachChild(const Expr& expr, F&& f) {
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+        case Expr::Kind::Name:
+            break;
+        case Expr::Kind::Unary:
+            f(*static_cast<const UnaryExpr&>(expr).operand);
+            break;
+        case Expr::Kind::Binary:
+            f(*static_cast<const BinaryExpr&>(expr).left);
+            f(*static_cast<const BinaryExpr&>(expr).right);
+            break;
+        case Expr::Kind::Compare:
+            for (auto& operand : static_cast<const CompareExpr&>(expr).operands) {
+                f(*operand);
+            }
+            break;
+        case Expr::Kind::Logical:
+            for (auto& operand : static_cast<const LogicalExpr&>(expr).operands) {
+                f(*operand);
+            }
+            break;
+        case Expr::Kind::Call:
+            f(*static_cast<const CallExpr&>(expr).atom);
+            for (auto& arg : static_cast<const CallExpr&>(expr).args) {
+                f(*arg.value);
+            }
+            break;
+        case Expr::Kind::Tuple:
+            for (auto& element : static_cast<const TupleExpr&>(expr).elements) {
+                f(*element);
+            }
+            break;
+        case Expr::Kind::FString:
+            for (auto& part : static_cast<const FStringExpr&>(expr).parts) {
+                if (part.expr) f(*part.expr);
+            }
+            break;
+    }
+}
+
+// Calls f on each expression the statements of a block evaluate in the
+// block's own frame: nested function bodies are skipped, defaults are not
+template <class F>
+void forEachStmtExpr(const Block& block, F&& f) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Expr:
+                f(*static_cast<const ExprStmt&>(*stmt).expr);
+                break;
+            case Stmt::Kind::Assign:
+                f(*static_cast<const AssignStmt&>(*stmt).value);
+                break;
+            case Stmt::Kind::AugAssign:
+                f(*static_cast<const AugAssignStmt&>(*stmt).value);
+                break;
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (size_t i = 0; i < ifStmt.conditions.size(); i++) {
+                    f(*ifStmt.conditions[i]);
+                    forEachStmtExpr(ifStmt.branches[i], f);
+                }
+                forEachStmtExpr(ifStmt.orelse, f);
+                break;
+            }
+            case Stmt::Kind::While:
+                f(*static_cast<const WhileStmt&>(*stmt).condition);
+                forEachStmtExpr(static_cast<const WhileStmt&>(*stmt).body, f);
+                break;
+            case Stmt::Kind::Return: {
+                auto& ret = static_cast<const ReturnStmt&>(*stmt);
+                if (ret.value) f(*ret.value);
+                break;
+            }
+            case Stmt::Kind::FunctionDef:
+                for (auto& value : static_cast<const FunctionDefStmt&>(*stmt).defaults) {
+                    f(*value);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+bool isComputation(const Expr& expr) {
+    return expr.kind != Expr::Kind::Constant && expr.kind != Expr::Kind::Name;
+}
+
+} // namespace
+
+bytecode::Module Compiler::compile(const Program& program) {
+    collectAssigned(program.body, globalNames);
+    collectFunctions(program.body, functionNames);
+    analyzePurity(program);
+    
+    module.functionNames = program.functionNames;
+    code = &module.main;
+    compileBlock(program.body);
+    emit(Op::Halt);
+    return std::move(module);
+}
+
+// Statements
+void Compiler::compileBlock(const Block& block) {
+    for (auto& stmt : block) {
+        compileStmt(*stmt);
+    }
+}
+
+void Compiler::compileStmt(const Stmt& stmt) {
+    // Temporaries only live for the statement that needs them
+    int savedReg = nextReg;
+    std::vector<std::string> shared;
+    shareCommon(stmt, shared);
+    
+    switch (stmt.kind) {
+        case Stmt::Kind::Expr:
+            compileExpr(*static_cast<const ExprStmt&>(stmt).expr, temp());
+            break;
+        case Stmt::Kind::Assign:
+            compileAssign(static_cast<const AssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::AugAssign:
+            compileAugAssign(static_cast<const AugAssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::If:
+            compileIf(static_cast<const IfStmt&>(stmt));
+            break;
+        case Stmt::Kind::While:
+            compileWhile(static_cast<const WhileStmt&>(stmt));
+            break;
+        case Stmt::Kind::Break:
+            // break and continue outside a loop have nothing to leave
+            if (!loops.empty()) loops.back().breaks.push_back(emit(Op::Jump));
+            break;
+        case Stmt::Kind::Continue:
+            if (!loops.empty()) emit(Op::Jump, loops.back().start);
+            break;
+        case Stmt::Kind::Return: {
+            auto& ret = static_cast<const ReturnStmt&>(stmt);
+            int value;
+            if (ret.value && ret.value->kind == Expr::Kind::Call && code != &module.main &&
+                static_cast<const CallExpr&>(*ret.value).builtin == Builtin::None) {
+                // A returned user call reuses this frame
+                value = temp();
+                compileCall(static_cast<const CallExpr&>(*ret.value), value, true);
+            } else if (ret.value) {
+                value = compileOperand(*ret.value);
+            } else {
+                value = temp();
+                emit(Op::LoadConst, value, constant(Value()));
+            }
+            emit(Op::Return, value);
+            break;
+        }
+        case Stmt::Kind::FunctionDef:
+            compileFunctionDef(static_cast<const FunctionDefStmt&>(stmt));
+            break;
+    }
+    
+    for (auto& key : shared) {
+        available.erase(key);
+    }
+    nextReg = savedReg;
+}
+
+void Compiler::compileAssign(const AssignStmt& stmt) {
+    // Parallel assignment a, b = x, y: evaluate into fresh registers and
+    // store them in order without building an intermediate tuple
+    if (stmt.targets.size() == 1 && stmt.value->kind == Expr::Kind::Tuple) {
+        auto& elements = static_cast<const TupleExpr&>(*stmt.value).elements;
+        auto& names = stmt.targets[0];
+        if (names.size() == elements.size()) {
+            std::vector<const Expr*> operands;
+            for (auto& element : elements) {
+                operands.push_back(element.get());
+            }
+            int first = compileOperands(operands);
+            for (size_t j = 0; j < names.size(); j++) {
+                if (!names[j].empty()) store(resolve(names[j]), first + j, false);
+            }
+            return;
+        }
+    }
+    
+    // x = expr builds the value straight in x's slot unless the expression
+    // would read x after that slot has been overwritten; x = x op y is safe
+    // because the left operand is read in place
+    if (stmt.targets.size() == 1 && stmt.targets[0].size() == 1 && !stmt.targets[0][0].empty()) {
+        auto& name = stmt.targets[0][0];
+        auto it = locals.find(name);
+        if (it != locals.end()) {
+            bool inPlace = !reads(*stmt.value, name);
+            if (stmt.value->kind == Expr::Kind::Binary) {
+                inPlace = inPlace || local(*static_cast<const BinaryExpr&>(*stmt.value).left) == it->second;
+            }
+            if (inPlace) {
+                compileExpr(*stmt.value, it->second);
+                return;
+            }
+        }
+    }
+    
+    // A value that already sits in a local's slot is copied, never moved from
+    int value = compileOperand(*stmt.value);
+    bool isLocal = local(*stmt.value) >= 0;
+    for (size_t i = 0; i < stmt.targets.size(); i++) {
+        auto& names = stmt.targets[i];
+        // Every target but the last leaves the value in place for the next one
+        bool keep = isLocal || i + 1 < stmt.targets.size();
+        
+        if (names.size() == 1) {
+            if (!names[0].empty()) store(resolve(names[0]), value, keep);
+        } else {
+            emit(Op::UnpackStore, targetList(names), value, keep);
+        }
+    }
+}
+
+void Compiler::compileAugAssign(const AugAssignStmt& stmt) {
+    int value = compileOperand(*stmt.value);
+    for (auto& name : stmt.targets) {
+        if (name.empty()) continue;
+        Target target = resolve(name);
+        if (target.kind == Target::Kind::Local) {
+            emit(bytecode::binaryOp(stmt.op), target.index, target.index, value);
+        } else {
+            emit(Op::AugGlobal, target.index, value, static_cast<int>(stmt.op));
+        }
+    }
+}
+
+void Compiler::compileIf(const IfStmt& stmt) {
+    std::vector<size_t> exits;
+    for (size_t i = 0; i < stmt.conditions.size(); i++) {
+        int savedReg = nextReg;
+        int condition = compileOperand(*stmt.conditions[i]);
+        nextReg = savedReg;
+        size_t next = emit(Op::JumpIfFalse, 0, condition);
+        compileBlock(stmt.branches[i]);
+        exits.push_back(emit(Op::Jump));
+        patch(next);
+    }
+    compileBlock(stmt.orelse);
+    for (size_t exit : exits) {
+        patch(exit);
+    }
+}
+
+void Compiler::compileWhile(const WhileStmt& stmt) {
+    std::vector<std::string> hoisted;
+    hoistInvariants(stmt, hoisted);
+    loops.push_back({here(), {}});
+    
+    // A constant true condition needs no test; the loop ends through break
+    bool unconditional = stmt.condition->kind == Expr::Kind::Constant &&
+                         static_cast<const ConstantExpr&>(*stmt.condition).value.toBool();
+    size_t exit = 0;
+    if (!unconditional) {
+        int savedReg = nextReg;
+        int condition = compileOperand(*stmt.condition);
+        nextReg = savedReg;
+        exit = emit(Op::JumpIfFalse, 0, condition);
+    }
+    compileBlock(stmt.body);
+    emit(Op::Jump, loops.back().start);
+    if (!unconditional) patch(exit);
+    
+    for (size_t jump : loops.back().breaks) {
+        patch(jump);
+    }
+    loops.pop_back();
+    for (auto& key : hoisted) {
+        available.erase(key);
+    }
+}
+
+void Compiler::compileFunctionDef(const FunctionDefStmt& stmt) {
+    // Defaults are evaluated where the def runs
+    std::vector<const Expr*> defaults;
+    for (auto& def : stmt.defaults) {
+        defaults.push_back(def.get());
+    }
+    int firstDefault = compileOperands(defaults);
+    
+    bytecode::FunctionCode func;
+    func.function = stmt.function;
+    func.defaultCount = stmt.defaults.size();
+    
+    // Parameters take the first slots; every other name the body assigns is
+    // a local unless top-level code assigns it too
+    std::map<std::string, int> outerLocals = std::move(locals);
+    std::map<std::string, int> outerAvailable = std::move(available);
+    locals.clear();
+    available.clear();
+    for (auto& param : stmt.params) {
+        func.params.push_back(name(param));
+        locals.emplace(param, locals.size());
+    }
+    std::set<std::string> assigned;
+    collectAssigned(stmt.body, assigned);
+    for (auto& var : assigned) {
+        if (!globalNames.count(var)) locals.emplace(var, locals.size());
+    }
+    func.numLocals = locals.size();
+    
+    // Compile the body into its own code object; functions is not appended
+    // to until the body is done, so nested definitions keep their indices
+    bytecode::CodeObject* outerCode = code;
+    int outerReg = nextReg;
+    std::vector<Loop> outerLoops = std::move(loops);
+    loops.clear();
+    code = &func.body;
+    code->numRegs = func.numLocals;
+    nextReg = func.numLocals;
+    
+    compileBlock(stmt.body);
+    int none = temp();
+    emit(Op::LoadConst, none, constant(Value()));
+    emit(Op::Return, none);
+    
+    code = outerCode;
+    nextReg = outerReg;
+    loops = std::move(outerLoops);
+    locals = std::move(outerLocals);
+    available = std::move(outerAvailable);
+    
+    module.functions.push_back(std::move(func));
+    emit(Op::MakeFunction, module.functions.size() - 1, firstDefault);
+}
+
+// Expressions
+void Compiler::compileExpr(const Expr& expr, int dst) {
+    int savedReg = nextReg;
+    
+    if (expr.kind != Expr::Kind::Name) {
+        int reg = local(expr);
+        if (reg >= 0) {
+            if (reg != dst) emit(Op::Copy, dst, reg);
+            return;
+        }
+    }
+    
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+            emit(Op::LoadConst, dst, constant(static_cast<const ConstantExpr&>(expr).value));
+            break;
+        case Expr::Kind::Name: {
+            auto& name = static_cast<const NameExpr&>(expr).name;
+            int slot = local(expr);
+            if (slot >= 0) {
+                if (slot != dst) emit(Op::Copy, dst, slot);
+            } else if (functionNames.count(name)) {
+                // A function name evaluates to its name as a string
+                emit(Op::LoadConst, dst, constant(Value(name)));
+            } else {
+                emit(Op::LoadGlobal, dst, global(name));
+            }
+            break;
+        }
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<const UnaryExpr&>(expr);
+            int operand = local(*unary.operand);
+            if (operand < 0) {
+                compileExpr(*unary.operand, dst);
+                operand = dst;
+            }
+            emit(unary.op == UnaryOp::Not ? Op::Not : Op::Neg, dst, operand);
+            break;
+        }
+        case Expr::Kind::Binary: {
+            // The left operand is read from its local's slot or built in place in dst
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            int left = local(*binary.left);
+            if (left < 0) {
+                compileExpr(*binary.left, dst);
+                left = dst;
+            }
+            int right = compileOperand(*binary.right);
+            emit(bytecode::binaryOp(binary.op), dst, left, right);
+            break;
+        }
+        case Expr::Kind::Compare:
+            compileCompare(static_cast<const CompareExpr&>(expr), dst);
+            break;
+        case Expr::Kind::Logical:
+            compileLogical(static_cast<const LogicalExpr&>(expr), dst);
+            break;
+        case Expr::Kind::Call:
+            compileCall(static_cast<const CallExpr&>(expr), dst);
+            break;
+        case Expr::Kind::Tuple: {
+            auto& tuple = static_cast<const TupleExpr&>(expr);
+            std::vector<const Expr*> elements;
+            for (auto& element : tuple.elements) {
+                elements.push_back(element.get());
+            }
+            int first = compileOperands(elements);
+            emit(Op::BuildTuple, dst, first, elements.size());
+            break;
+        }
+        case Expr::Kind::FString: {
+            auto& fstring = static_cast<const FStringExpr&>(expr);
+            int first = nextReg;
+            for (auto& part : fstring.parts) {
+                int reg = temp();
+                if (part.expr) compileExpr(*part.expr, reg);
+                else emit(Op::LoadConst, reg, constant(Value(part.literal)));
+            }
+            emit(Op::Format, dst, first, fstring.parts.size());
+            break;
+        }
+    }
+    
+    nextReg = savedReg;
+}
+
+void Compiler::compileCompare(const CompareExpr& expr, int dst) {
+    if (expr.ops.size() == 1) {
+        int left = local(*expr.operands[0]);
+        if (left < 0) {
+            compileExpr(*expr.operands[0], dst);
+            left = dst;
+        }
+        int right = compileOperand(*expr.operands[1]);
+        emit(bytecode::compareOp(expr.ops[0]), dst, left, right);
+        return;
+    }
+    
+    // A chain is its links joined by and: each operand is evaluated at most
+    // once, and not at all after a false link. The links go to a temporary,
+    // since dst may be a local that a later operand reads
+    int result = temp();
+    int left = compileOperand(*expr.operands[0]);
+    std::vector<size_t> exits;
+    for (size_t i = 0; i < expr.ops.size(); i++) {
+        int right = compileOperand(*expr.operands[i + 1]);
+        emit(bytecode::compareOp(expr.ops[i]), result, left, right);
+        if (i + 1 < expr.ops.size()) exits.push_back(emit(Op::JumpIfFalse, 0, result));
+        left = right;
+    }
+    for (size_t exit : exits) {
+        patch(exit);
+    }
+    emit(Op::Move, dst, result);
+}
+
+void Compiler::compileLogical(const LogicalExpr& expr, int dst) {
+    Op jump = expr.op == LogicalOp::And ? Op::JumpIfFalse : Op::JumpIfTrue;
+    std::vector<size_t> exits;
+    
+    compileExpr(*expr.operands[0], dst);
+    for (size_t i = 1; i < expr.operands.size(); i++) {
+        exits.push_back(emit(jump, 0, dst));
+        compileExpr(*expr.operands[i], dst);
+    }
+    for (size_t exit : exits) {
+        patch(exit);
+    }
+}
+
+void Compiler::compileCall(const CallExpr& expr, int dst, bool tail) {
+    std::vector<const Expr*> args;
+    for (auto& arg : expr.args) {
+        args.push_back(arg.value.get());
+    }
+    
+    // Built-in functions
+    if (expr.builtin == Builtin::Print) {
+        int first = compileOperands(args);
+        emit(Op::Print, dst, first, args.size());
+        return;
+    }
+    if (expr.builtin != Builtin::None) {
+        int arg = args.empty() ? -1 : local(*args[0]);
+        if (arg < 0) {
+            if (args.empty()) emit(Op::LoadConst, dst, constant(Value()));
+            else compileExpr(*args[0], dst);
+            arg = dst;
+        }
+        emit(Op::Convert, dst, arg, static_cast<int>(expr.builtin));
+        return;
+    }
+    
+    bytecode::CallSite site;
+    site.function = expr.function;
+    site.firstArg = compileOperands(args);
+    for (auto& arg : expr.args) {
+        site.keywords.push_back(arg.keyword.empty() ? -1 : name(arg.keyword));
+    }
+    module.callSites.push_back(std::move(site));
+    size_t call = emit(tail ? Op::TailCall : Op::Call, dst, module.callSites.size() - 1);
+    
+    // Without a user function of that name the call evaluates its atom
+    compileExpr(*expr.atom, dst);
+    code->code[call].c = here();
+}
+
+// Returns the register holding the expression's value: a local's own slot,
+// or a fresh temporary the value is evaluated into
+int Compiler::compileOperand(const Expr& expr) {
+    int slot = local(expr);
+    if (slot >= 0) return slot;
+    int reg = temp();
+    compileExpr(expr, reg);
+    return reg;
+}
+
+// Evaluates the operands into consecutive fresh registers; returns the first
+int Compiler::compileOperands(const std::vector<const Expr*>& operands) {
+    int first = nextReg;
+    for (size_t i = 0; i < operands.size(); i++) {
+        temp();
+    }
+    for (size_t i = 0; i < operands.size(); i++) {
+        compileExpr(*operands[i], first + i);
+    }
+    return first;
+}
+
+// Precomputed subexpressions
+// Computes the loop's invariant subexpressions into registers that stay
+// reserved until the loop is compiled
+void Compiler::hoistInvariants(const WhileStmt& stmt, std::vector<std::string>& keys) {
+    std::set<std::string> assigned;
+    collectAssigned(stmt.body, assigned);
+    bool globalsStable = !callsImpure(*stmt.condition);
+    forEachStmtExpr(stmt.body, [&](const Expr& expr) {
+        globalsStable = globalsStable && !callsImpure(expr);
+    });
+    
+    std::function<void(const Expr&)> hoist = [&](const Expr& expr) {
+        std::string key;
+        if (isComputation(expr) && expressionKey(expr, key) && stable(expr, assigned, globalsStable)) {
+            if (!available.count(key)) {
+                int reg = temp();
+                compileExpr(expr, reg);
+                available.emplace(key, reg);
+                keys.push_back(key);
+            }
+            return;
+        }
+        forEachChild(expr, hoist);
+    };
+    hoist(*stmt.condition);
+    forEachStmtExpr(stmt.body, hoist);
+}
+
+// Computes the subexpressions that occur more than once in a simple statement
+// into registers that stay reserved until the statement is compiled
+void Compiler::shareCommon(const Stmt& stmt, std::vector<std::string>& keys) {
+    const Expr* root = nullptr;
+    switch (stmt.kind) {
+        case Stmt::Kind::Expr: root = static_cast<const ExprStmt&>(stmt).expr.get(); break;
+        case Stmt::Kind::Assign: root = static_cast<const AssignStmt&>(stmt).value.get(); break;
+        case Stmt::Kind::AugAssign: root = static_cast<const AugAssignStmt&>(stmt).value.get(); break;
+        case Stmt::Kind::Return: root = static_cast<const ReturnStmt&>(stmt).value.get(); break;
+        default: break;
+    }
+    if (!root) return;
+    
+    std::map<std::string, int> counts;
+    std::function<void(const Expr&)> count = [&](const Expr& expr) {
+        std::string key;
+        if (isComputation(expr) && expressionKey(expr, key)) counts[key]++;
+        forEachChild(expr, count);
+    };
+    count(*root);
+    
+    // Nothing the statement evaluates writes a local, and only an impure call
+    // can write a global between two occurrences
+    std::set<std::string> assigned;
+    bool globalsStable = !callsImpure(*root);
+    std::function<void(const Expr&)> share = [&](const Expr& expr) {
+        std::string key;
+        if (isComputation(expr) && expressionKey(expr, key) && counts[key] > 1) {
+            if (available.count(key)) return;
+            if (stable(expr, assigned, globalsStable)) {
+                int reg = temp();
+                compileExpr(expr, reg);
+                available.emplace(key, reg);
+                keys.push_back(key);
+                return;
+            }
+        }
+        forEachChild(expr, share);
+    };
+    share(*root);
+}
+
+// Writes a structural key for a pure expression that cannot fail, so equal
+// keys compute equal values from equal variables; false for anything else
+bool Compiler::expressionKey(const Expr& expr, std::string& out) const {
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+            out += 'c';
+            MemoCache::appendKey(out, static_cast<const ConstantExpr&>(expr).value);
+            return true;
+        case Expr::Kind::Name:
+            out += 'n';
+            out += static_cast<const NameExpr&>(expr).name;
+            out += ';';
+            return true;
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<const UnaryExpr&>(expr);
+            out += 'u';
+            out += static_cast<char>('0' + static_cast<int>(unary.op));
+            return expressionKey(*unary.operand, out);
+        }
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            // Division and modulo fail on zero unless the divisor is known
+            if (binary.op == BinaryOp::Div || binary.op == BinaryOp::FloorDiv || binary.op == BinaryOp::Mod) {
+                if (binary.right->kind != Expr::Kind::Constant ||
+                    !static_cast<const ConstantExpr&>(*binary.right).value.toBool()) return false;
+            }
+            out += 'b';
+            out += static_cast<char>('0' + static_cast<int>(binary.op));
+            return expressionKey(*binary.left, out) && expressionKey(*binary.right, out);
+        }
+        case Expr::Kind::Compare: {
+            auto& compare = static_cast<const CompareExpr&>(expr);
+            out += 'k';
+            for (auto op : compare.ops) {
+                out += static_cast<char>('0' + static_cast<int>(op));
+            }
+            out += '(';
+            for (auto& operand : compare.operands) {
+                if (!expressionKey(*operand, out)) return false;
+            }
+            out += ')';
+            return true;
+        }
+        case Expr::Kind::Logical: {
+            auto& logical = static_cast<const LogicalExpr&>(expr);
+            out += 'l';
+            out += static_cast<char>('0' + static_cast<int>(logical.op));
+            out += '(';
+            for (auto& operand : logical.operands) {
+                if (!expressionKey(*operand, out)) return false;
+            }
+            out += ')';
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Whether the expression reads only variables that keep their values: locals
+// the loop does not assign, and globals as well unless something may write
+// them
+bool Compiler::stable(const Expr& expr, const std::set<std::string>& assigned, bool globalsStable) const {
+    if (expr.kind == Expr::Kind::Name) {
+        auto& name = static_cast<const NameExpr&>(expr).name;
+        if (assigned.count(name)) return false;
+        if (locals.count(name) || functionNames.count(name)) return true;
+        return globalsStable;
+    }
+    bool result = true;
+    forEachChild(expr, [&](const Expr& child) {
+        result = result && stable(child, assigned, globalsStable);
+    });
+    return result;
+}
+
+bool Compiler::callsImpure(const Expr& expr) const {
+    if (expr.kind == Expr::Kind::Call) {
+        auto& call = static_cast<const CallExpr&>(expr);
+        if (call.builtin == Builtin::None && !module.pureFunctions[call.function]) return true;
+    }
+    bool result = false;
+    forEachChild(expr, [&](const Expr& child) {
+        result = result || callsImpure(child);
+    });
+    return result;
+}
+
+// Scopes
+Target Compiler::resolve(const std::string& name) {
+    auto it = locals.find(name);
+    if (it != locals.end()) return {Target::Kind::Local, it->second};
+    return {Target::Kind::Global, global(name)};
+}
+
+void Compiler::store(const Target& target, int src, bool keep) {
+    if (target.kind == Target::Kind::Global) {
+        emit(Op::StoreGlobal, target.index, src, keep);
+    } else if (target.index != src) {
+        emit(keep ? Op::Copy : Op::Move, target.index, src);
+    }
+}
+
+// The register already holding the expression's value: the slot of a local
+// variable or of a precomputed subexpression; -1 otherwise
+int Compiler::local(const Expr& expr) const {
+    if (expr.kind == Expr::Kind::Name) {
+        auto it = locals.find(static_cast<const NameExpr&>(expr).name);
+        return it == locals.end() ? -1 : it->second;
+    }
+    std::string key;
+    if (available.empty() || expr.kind == Expr::Kind::Constant || !expressionKey(expr, key)) return -1;
+    auto it = available.find(key);
+    return it == available.end() ? -1 : it->second;
+}
+
+// Names assigned in a block, not counting nested function bodies
+void Compiler::collectAssigned(const Block& block, std::set<std::string>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Assign:
+                for (auto& names : static_cast<const AssignStmt&>(*stmt).targets) {
+                    for (auto& name : names) {
+                        if (!name.empty()) out.insert(name);
+                    }
+                }
+                break;
+            case Stmt::Kind::AugAssign:
+                for (auto& name : static_cast<const AugAssignStmt&>(*stmt).targets) {
+                    if (!name.empty()) out.insert(name);
+                }
+                break;
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    collectAssigned(branch, out);
+                }
+                collectAssigned(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While:
+                collectAssigned(static_cast<const WhileStmt&>(*stmt).body, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Names of all def statements, at any depth
+void Compiler::collectFunctions(const Block& block, std::set<std::string>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::FunctionDef: {
+                auto& def = static_cast<const FunctionDefStmt&>(*stmt);
+                out.insert(def.name);
+                collectFunctions(def.body, out);
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    collectFunctions(branch, out);
+                }
+                collectFunctions(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While:
+                collectFunctions(static_cast<const WhileStmt&>(*stmt).body, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Definitions of all def statements, at any depth
+void Compiler::collectDefinitions(const Block& block, std::vector<const FunctionDefStmt*>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::FunctionDef: {
+                auto& def = static_cast<const FunctionDefStmt&>(*stmt);
+                out.push_back(&def);
+                collectDefinitions(def.body, out);
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    collectDefinitions(branch, out);
+                }
+                collectDefinitions(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While:
+                collectDefinitions(static_cast<const WhileStmt&>(*stmt).body, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+bool Compiler::reads(const Expr& expr, const std::string& name) {
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+            return false;
+        case Expr::Kind::Name:
+            return static_cast<const NameExpr&>(expr).name == name;
+        case Expr::Kind::Unary:
+            return reads(*static_cast<const UnaryExpr&>(expr).operand, name);
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            return reads(*binary.left, name) || reads(*binary.right, name);
+        }
+        case Expr::Kind::Compare:
+            return std::any_of(static_cast<const CompareExpr&>(expr).operands.begin(),
+                static_cast<const CompareExpr&>(expr).operands.end(),
+                [&](const ExprPtr& operand) { return reads(*operand, name); });
+        case Expr::Kind::Logical:
+            return std::any_of(static_cast<const LogicalExpr&>(expr).operands.begin(),
+                static_cast<const LogicalExpr&>(expr).operands.end(),
+                [&](const ExprPtr& operand) { return reads(*operand, name); });
+        case Expr::Kind::Call: {
+            auto& call = static_cast<const CallExpr&>(expr);
+            if (reads(*call.atom, name)) return true;
+            return std::any_of(call.args.begin(), call.args.end(),
+                [&](const Argument& arg) { return reads(*arg.value, name); });
+        }
+        case Expr::Kind::Tuple:
+            return std::any_of(static_cast<const TupleExpr&>(expr).elements.begin(),
+                static_cast<const TupleExpr&>(expr).elements.end(),
+                [&](const ExprPtr& element) { return reads(*element, name); });
+        case Expr::Kind::FString:
+            return std::any_of(static_cast<const FStringExpr&>(expr).parts.begin(),
+                static_cast<const FStringExpr&>(expr).parts.end(),
+                [&](const FStringExpr::Part& part) { return part.expr && reads(*part.expr, name); });
+    }
+    return false;
+}
+
+// Emission
+int Compiler::temp() {
+    code->numRegs = std::max(code->numRegs, nextReg + 1);
+    return nextReg++;
+}
+
+size_t Compiler::emit(Op op, int a, int b, int c) {
+    code->code.push_back({op, 0, a, b, c});
+    return code->code.size() - 1;
+}
+
+// Points the jump at `at` to the current end of the code
+void Compiler::patch(size_t at) {
+    code->code[at].a = here();
+}
+
+int Compiler::name(const std::string& s) {
+    auto it = nameIndex.find(s);
+    if (it != nameIndex.end()) return it->second;
+    module.names.push_back(s);
+    return nameIndex[s] = module.names.size() - 1;
+}
+
+int Compiler::global(const std::string& s) {
+    auto it = globalIndex.find(s);
+    if (it != globalIndex.end()) return it->second;
+    module.globalNames.push_back(s);
+    return globalIndex[s] = module.globalNames.size() - 1;
+}
+
+int Compiler::constant(Value v) {
+    module.constants.push_back(std::move(v));
+    return module.constants.size() - 1;
+}
+
+int Compiler::targetList(const std::vector<std::string>& names) {
+    std::vector<Target> targets;
+    for (auto& target : names) {
+        targets.push_back(target.empty() ? Target{Target::Kind::None, 0} : resolve(target));
+    }
+    module.targetLists.push_back(std::move(targets));
+    return module.targetLists.size() - 1;
+}
+
+// Purity
+// A function slot is pure when none of its definitions prints, defines a
+// function or touches a global, and every function it calls is pure; its
+// result then depends on nothing but its arguments and the functions defined
+void Compiler::analyzePurity(const Program& program) {
+    auto& pure = module.pureFunctions;
+    pure.assign(program.functionNames.size(), 1);
+    std::vector<std::set<int>> calls(pure.size());
+    
+    std::vector<const FunctionDefStmt*> defs;
+    collectDefinitions(program.body, defs);
+    for (auto def : defs) {
+        std::set<std::string> params(def->params.begin(), def->params.end());
+        if (!isolated(def->body, params, calls[def->function])) pure[def->function] = 0;
+    }
+    
+    // Calling an impure function makes the caller impure
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t slot = 0; slot < pure.size(); slot++) {
+            if (!pure[slot]) continue;
+            for (int callee : calls[slot]) {
+                if (pure[callee]) continue;
+                pure[slot] = 0;
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+// Whether the code only reads and writes its own frame; calls to user
+// functions are collected for the caller to check
+bool Compiler::isolated(const Block& block, const std::set<std::string>& params, std::set<int>& calls) const {
+    auto local = [&](const std::string& name) {
+        return name.empty() || params.count(name) || !globalNames.count(name);
+    };
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Expr:
+                if (!isolated(*static_cast<const ExprStmt&>(*stmt).expr, params, calls)) return false;
+                break;
+            case Stmt::Kind::Assign: {
+                auto& assign = static_cast<const AssignStmt&>(*stmt);
+                for (auto& names : assign.targets) {
+                    if (!std::all_of(names.begin(), names.end(), local)) return false;
+                }
+                if (!isolated(*assign.value, params, calls)) return false;
+                break;
+            }
+            case Stmt::Kind::AugAssign: {
+                auto& aug = static_cast<const AugAssignStmt&>(*stmt);
+                if (!std::all_of(aug.targets.begin(), aug.targets.end(), local)) return false;
+                if (!isolated(*aug.value, params, calls)) return false;
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (size_t i = 0; i < ifStmt.conditions.size(); i++) {
+                    if (!isolated(*ifStmt.conditions[i], params, calls)) return false;
+                    if (!isolated(ifStmt.branches[i], params, calls)) return false;
+                }
+                if (!isolated(ifStmt.orelse, params, calls)) return false;
+                break;
+            }
+            case Stmt::Kind::While: {
+                auto& whileStmt = static_cast<const WhileStmt&>(*stmt);
+                if (!isolated(*whileStmt.condition, params, calls)) return false;
+                if (!isolated(whileStmt.body, params, calls)) return false;
+                break;
+            }
+            case Stmt::Kind::Return: {
+                auto& ret = static_cast<const ReturnStmt&>(*stmt);
+                if (ret.value && !isolated(*ret.value, params, calls)) return false;
+                break;
+            }
+            case Stmt::Kind::FunctionDef:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+bool Compiler::isolated(const Expr& expr, const std::set<std::string>& params, std::set<int>& calls) const {
+    auto each = [&](const std::vector<ExprPtr>& exprs) {
+        return std::all_of(exprs.begin(), exprs.end(),
+            [&](const ExprPtr& e) { return isolated(*e, params, calls); });
+    };
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+            return true;
+        case Expr::Kind::Name: {
+            auto& name = static_cast<const NameExpr&>(expr).name;
+            return params.count(name) || !globalNames.count(name);
+        }
+        case Expr::Kind::Unary:
+            return isolated(*static_cast<const UnaryExpr&>(expr).operand, params, calls);
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            return isolated(*binary.left, params, calls) && isolated(*binary.right, params, calls);
+        }
+        case Expr::Kind::Compare:
+            return each(static_cast<const CompareExpr&>(expr).operands);
+        case Expr::Kind::Logical:
+            return each(static_cast<const LogicalExpr&>(expr).operands);
+        case Expr::Kind::Call: {
+            auto& call = static_cast<const CallExpr&>(expr);
+            if (call.builtin == Builtin::Print) return false;
+            if (call.builtin == Builtin::None) calls.insert(call.function);
+            if (!isolated(*call.atom, params, calls)) return false;
+            return std::all_of(call.args.begin(), call.args.end(),
+                [&](const Argument& arg) { return isolated(*arg.value, params, calls); });
+        }
+        case Expr::Kind::Tuple:
+            return each(static_cast<const TupleExpr&>(expr).elements);
+        case Expr::Kind::FString:
+            return std::all_of(static_cast<const FStringExpr&>(expr).parts.begin(),
+                static_cast<const FStringExpr&>(expr).parts.end(),
+                [&](const FStringExpr::Part& part) { return !part.expr || isolated(*part.expr, params, calls); });
+    }
+    return false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_COMPILER_H
+#define PYTHON_INTERPRETER_COMPILER_H
+
+#include "Ast.h"
+#include "Bytecode.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Compiles an ast::Program into a bytecode::Module for the VM. Variable names
+// are resolved statically: names assigned by top-level code are globals
+// everywhere, and a function's parameters and the other names it assigns
+// become register slots of its frame. Only parameters shadow globals.
+//
+// Pure subexpressions that cannot fail are computed ahead of their uses:
+// loop invariants once before their while loop, and subexpressions that
+// occur more than once in a statement once before that statement. Only
+// assignments write locals, and only calls of impure user functions can
+// write globals behind the compiler's back.
+class Compiler {
+public:
+    bytecode::Module compile(const ast::Program& program);
+
+private:
+    // Jump sites of the innermost enclosing while loops
+    struct Loop {
+        size_t start;
+        std::vector<size_t> breaks;
+    };
+    
+    bytecode::Module module;
+    bytecode::CodeObject* code = nullptr;
+    std::map<std::string, int> nameIndex;
+    std::map<std::string, int> globalIndex;
+    std::set<std::string> globalNames;
+    std::set<std::string> functionNames;
+    std::map<std::string, int> locals;      // slots of the function being compiled
+    std::map<std::string, int> available;   // registers of precomputed subexpressions by key
+    std::vector<Loop> loops;
+    int nextReg = 0;
+    
+    void compileBlock(const ast::Block& block);
+    void compileStmt(const ast::Stmt& stmt);
+    void compileAssign(const ast::AssignStmt& stmt);
+    void compileAugAssign(const ast::AugAssignStmt& stmt);
+    void compileIf(const ast::IfStmt& stmt);
+    void compileWhile(const ast::WhileStmt& stmt);
+    void compileFunctionDef(const ast::FunctionDefStmt& stmt);
+    
+    // Each expression is compiled to leave its value in register dst
+    void compileExpr(const ast::Expr& expr, int dst);
+    void compileCompare(const ast::CompareExpr& expr, int dst);
+    void compileLogical(const ast::LogicalExpr& expr, int dst);
+    void compileCall(const ast::CallExpr& expr, int dst, bool tail = false);
+    int compileOperand(const ast::Expr& expr);
+    int compileOperands(const std::vector<const ast::Expr*>& operands);
+    
+    void hoistInvariants(const ast::WhileStmt& stmt, std::vector<std::string>& keys);
+    void shareCommon(const ast::Stmt& stmt, std::vector<std::string>& keys);
+    bool expressionKey(const ast::Expr& expr, std::string& out) const;
+    bool stable(const ast::Expr& expr, const std::set<std::string>& assigned, bool globalsStable) const;
+    bool callsImpure(const ast::Expr& expr) const;
+    
+    bytecode::Target resolve(const std::string& name);
+    void store(const bytecode::Target& target, int src, bool keep);
+    int local(const ast::Expr& expr) const;
+    static void collectAssigned(const ast::Block& block, std::set<std::string>& out);
+    static void collectFunctions(const ast::Block& block, std::set<std::string>& out);
+    static bool reads(const ast::Expr& expr, const std::string& name);
+    
+    void analyzePurity(const ast::Program& program);
+    bool isolated(const ast::Block& block, const std::set<std::string>& params, std::set<int>& calls) const;
+    bool isolated(const ast::Expr& expr, const std::set<std::string>& params, std::set<int>& calls) const;
+    static void collectDefinitions(const ast::Block& block, std::vector<const ast::FunctionDefStmt*>& out);
+    
+    int temp();
+    size_t emit(bytecode::Op op, int a = 0, int b = 0, int c = 0);
+    void patch(size_t at);
+    size_t here() const { return code->code.size(); }
+    int name(const std::string& s);
+    int global(const std::string& s);
+    int constant(Value v);
+    int targetList(const std::vector<std::string>& names);
+};
+
+#endif//PYTHON_INTERPRETER_COMPILER_H
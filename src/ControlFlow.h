@@ -0,0 +1,10 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_CONTROLFLOW_H
+#define PYTHON_INTERPRETER_CONTROLFLOW_H
+
+// How a statement finished. Anything but Normal unwinds the enclosing blocks
+// up to the loop or call that handles it; a return leaves its value in the
+// current Frame.
+enum class Completion { Normal, Return, Break, Continue };
+
+#endif//PYTHON_INTERPRETER_CONTROLFLOW_H
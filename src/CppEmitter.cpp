@@ -0,0 +1,1530 @@
+#include "CppEmitter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace ast;
+
+namespace {
+
+// Support code at the top of every generated translation unit; print and
+// format write doubles and bools the way Value::appendTo writes them
+const char* const kRuntime = R"(#include "Ast.h"
+#include "Unboxed.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <utility>
+
+namespace {
+
+using namespace ast;
+
+// Calls nest as deep as VM::kDefaultMaxDepth allows; the program runs on a
+// thread with a stack to match
+const int kMaxDepth = 100000;
+const size_t kStackSize = size_t(1) << 30;
+int depth = 0;
+
+[[noreturn]] void recursionError() {
+    std::cout.flush();
+    std::cerr << "RecursionError: maximum recursion depth exceeded" << std::endl;
+    std::exit(1);
+}
+
+struct Frame {
+    Frame() { if (++depth > kMaxDepth) recursionError(); }
+    ~Frame() { depth--; }
+};
+
+// A tail call replaces the caller's frame, as VM's TailCall does
+struct TailCall {
+    TailCall() { depth--; }
+    ~TailCall() { depth++; }
+};
+
+// An int local: a machine word until a result no longer fits in one
+class Int {
+public:
+    Int() = default;
+    Int(int64_t n) : small(n) {}
+    explicit Int(const BigInt& n) {
+        long long fits;
+        if (n.toLongLong(fits)) small = fits;
+        else big = std::make_unique<BigInt>(n);
+    }
+    Int(const Int& other) : small(other.small), big(other.big ? std::make_unique<BigInt>(*other.big) : nullptr) {}
+    Int(Int&& other) noexcept = default;
+    Int& operator=(const Int& other) { return *this = Int(other); }
+    Int& operator=(Int&& other) noexcept = default;
+    
+    bool isSmall() const { return !big; }
+    int64_t value() const { return small; }
+    BigInt wide() const { return big ? *big : BigInt(static_cast<long long>(small)); }
+    bool toBool() const { return big ? !big->isZero() : small != 0; }
+    double toDouble() const { return big ? big->toDouble() : static_cast<double>(small); }
+
+private:
+    int64_t small = 0;
+    std::unique_ptr<BigInt> big;
+};
+
+#define INT_OPERATOR(name, op, checked) \
+    Int name(const Int& a, const Int& b) { \
+        int64_t result; \
+        if (a.isSmall() && b.isSmall() && checked(a.value(), b.value(), result)) return Int(result); \
+        return Int(a.wide() op b.wide()); \
+    }
+INT_OPERATOR(operator+, +, addI64)
+INT_OPERATOR(operator-, -, subI64)
+INT_OPERATOR(operator*, *, mulI64)
+INT_OPERATOR(floordiv, /, floorDivI64)
+INT_OPERATOR(operator%, %, modI64)
+#undef INT_OPERATOR
+
+Int operator-(const Int& a) {
+    if (a.isSmall() && a.value() != INT64_MIN) return Int(-a.value());
+    return Int(-a.wide());
+}
+
+bool operator<(const Int& a, const Int& b) {
+    return a.isSmall() && b.isSmall() ? a.value() < b.value() : a.wide() < b.wide();
+}
+bool operator==(const Int& a, const Int& b) {
+    return a.isSmall() && b.isSmall() ? a.value() == b.value() : a.wide() == b.wide();
+}
+bool operator>(const Int& a, const Int& b) { return b < a; }
+bool operator<=(const Int& a, const Int& b) { return !(b < a); }
+bool operator>=(const Int& a, const Int& b) { return !(a < b); }
+bool operator!=(const Int& a, const Int& b) { return !(a == b); }
+
+Value box(const Int& n) {
+    return n.isSmall() ? boxI64(n.value()) : Value(n.wide());
+}
+
+std::string printBuffer;
+
+void append(std::string& out, const Value& value) { value.appendTo(out); }
+void append(std::string& out, double value) { Value::appendFloat(out, value); }
+void append(std::string& out, bool value) { out += value ? "True" : "False"; }
+void append(std::string& out, const Int& value) {
+    if (!value.isSmall()) return value.wide().appendTo(out);
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value.value()).ptr);
+}
+
+template <class... Args>
+void print(const Args&... args) {
+    printBuffer.clear();
+    size_t i = 0;
+    ((printBuffer += i++ ? " " : "", append(printBuffer, args)), ...);
+    printBuffer += '\n';
+    std::cout.write(printBuffer.data(), printBuffer.size());
+}
+
+template <class... Args>
+Value format(const Args&... args) {
+    std::string result;
+    (append(result, args), ...);
+    return Value(result);
+}
+
+template <class... Args>
+Value makeTuple(Args&&... items) {
+    TupleRef tuple = Tuple::make(sizeof...(items));
+    size_t i = 0;
+    (((*tuple.get())[i++] = Value(std::forward<Args>(items))), ...);
+    return Value(std::move(tuple));
+}
+
+// a, b = value; null targets are skipped
+void unpack(const Value& value, std::initializer_list<Value*> targets) {
+    if (value.type != Value::TUPLE) return;
+    size_t i = 0;
+    for (Value* target : targets) {
+        if (i == value.tupleVal.size()) break;
+        if (target) *target = value.tupleVal[i];
+        i++;
+    }
+}
+)";
+
+// Calls f on each direct subexpression
+template <class F>
+void forEachChild(const Expr& expr, F&& f) {
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+        case Expr::Kind::Name:
+            break;
+        case Expr::Kind::Unary:
+            f(*static_cast<const UnaryExpr&>(expr).operand);
+            break;
+        case Expr::Kind::Binary:
+            f(*static_cast<const BinaryExpr&>(expr).left);
+            f(*static_cast<const BinaryExpr&>(expr).right);
+            break;
+        case Expr::Kind::Compare:
+            for (auto& operand : static_cast<const CompareExpr&>(expr).operands) {
+                f(*operand);
+            }
+            break;
+        case Expr::Kind::Logical:
+            for (auto& operand : static_cast<const LogicalExpr&>(expr).operands) {
+                f(*operand);
+            }
+            break;
+        case Expr::Kind::Call: {
+            auto& call = static_cast<const CallExpr&>(expr);
+            f(*call.atom);
+            for (auto& arg : call.args) {
+                f(*arg.value);
+            }
+            break;
+        }
+        case Expr::Kind::Tuple:
+            for (auto& element : static_cast<const TupleExpr&>(expr).elements) {
+                f(*element);
+            }
+            break;
+        case Expr::Kind::FString:
+            for (auto& part : static_cast<const FStringExpr&>(expr).parts) {
+                if (part.expr) f(*part.expr);
+            }
+            break;
+    }
+}
+
+// An int literal the double arithmetic can take as a double constant
+bool isIntConstant(const Expr& expr) {
+    if (expr.kind != Expr::Kind::Constant) return false;
+    auto& value = static_cast<const ConstantExpr&>(expr).value;
+    return value.type == Value::INT && std::isfinite(value.intVal.toDouble());
+}
+
+// An int literal that fits in an Int's machine word
+bool isSmallInt(const Value& value, long long& n) {
+    return value.type == Value::INT && value.intVal.toLongLong(n);
+}
+
+const char* binarySymbol(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add: return "+";
+        case BinaryOp::Sub: return "-";
+        case BinaryOp::Mul: return "*";
+        case BinaryOp::Div: return "/";
+        case BinaryOp::FloorDiv: return "//";
+        case BinaryOp::Mod: return "%";
+    }
+    return "";
+}
+
+const char* compareSymbol(CompareOp op) {
+    switch (op) {
+        case CompareOp::Lt: return "<";
+        case CompareOp::Gt: return ">";
+        case CompareOp::Le: return "<=";
+        case CompareOp::Ge: return ">=";
+        case CompareOp::Eq: return "==";
+        case CompareOp::Ne: return "!=";
+    }
+    return "";
+}
+
+} // namespace
+
+void CppEmitter::emit(const Program& program, std::ostream& os) {
+    collectAssigned(program.body, globalNames);
+    collectDefinitions(program.body, definitions);
+    for (size_t i = 0; i < definitions.size(); i++) {
+        functionNames.insert(definitions[i]->name);
+        definitionsOf[definitions[i]->function].push_back(i + 1);
+    }
+    slotNames = &program.functionNames;
+    
+    // A def whose parameters are used as operands gets a variant taking them
+    // as Ints, as long as the body never assigns them anything else
+    for (size_t i = 0; i < definitions.size(); i++) {
+        auto& def = *definitions[i];
+        std::set<std::string> operands;
+        collectOperands(def.body, operands);
+        std::vector<bool> ints(def.params.size());
+        for (size_t p = 0; p < def.params.size(); p++) {
+            ints[p] = operands.count(def.params[p]) > 0;
+        }
+        bool changed = true;
+        while (changed && std::count(ints.begin(), ints.end(), true) > 0) {
+            inferLocals(def, ints);
+            changed = false;
+            for (size_t p = 0; p < def.params.size(); p++) {
+                if (ints[p] && locals[def.params[p]] != Type::Int) {
+                    ints[p] = false;
+                    changed = true;
+                }
+            }
+        }
+        if (std::count(ints.begin(), ints.end(), true) > 0) intParams[i + 1] = ints;
+    }
+    
+    std::vector<std::string> functions(definitions.size());
+    for (size_t i = 0; i < definitions.size(); i++) {
+        emitFunction(i + 1, functions[i]);
+    }
+    // Top-level code is split over functions of a bounded size, since the
+    // optimizer takes time quadratic in the size of a function
+    std::vector<std::string> chunks(1);
+    locals.clear();
+    inFunction = false;
+    indent = 1;
+    nextTemp = 0;
+    for (auto& stmt : program.body) {
+        if (std::count(chunks.back().begin(), chunks.back().end(), '\n') >= kMaxChunkLines) chunks.emplace_back();
+        out = &chunks.back();
+        emitStmt(*stmt);
+    }
+    
+    // Declarations come in paragraphs: constants, globals, then the function
+    // slots with the defaults of each def
+    std::vector<std::string> paragraphs(3);
+    for (size_t i = 0; i < constants.size(); i++) {
+        paragraphs[0] += "const Value k" + std::to_string(i) + " = " + constants[i] + ";\n";
+    }
+    for (auto& name : referencedGlobals) {
+        paragraphs[1] += "Value g_" + mangle(name) + ";\n";
+    }
+    for (auto& entry : definitionsOf) {
+        paragraphs[2] += "int bound_" + mangle((*slotNames)[entry.first]) + " = 0;\n";
+    }
+    for (size_t i = 0; i < definitions.size(); i++) {
+        if (definitions[i]->defaults.empty()) continue;
+        paragraphs[2] += "Value defaults" + std::to_string(i + 1) + "[" + std::to_string(definitions[i]->defaults.size()) + "];\n";
+    }
+    for (size_t i = 0; i < definitions.size(); i++) {
+        paragraphs[2] += signature(i + 1, false) + ";\n";
+        if (intParams.count(i + 1)) paragraphs[2] += signature(i + 1, true) + ";\n";
+    }
+    paragraphs.insert(paragraphs.end(), functions.begin(), functions.end());
+    // A top-level return makes its chunk return false
+    std::string runs;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        paragraphs.push_back("bool run" + std::to_string(i) + "() {\n" + chunks[i] + "    return true;\n}\n");
+        runs += (i > 0 ? ", run" : "run") + std::to_string(i);
+    }
+    paragraphs.push_back("void* run(void*) {\n"
+                         "    for (auto chunk : {" + runs + "}) {\n"
+                         "        if (!chunk()) break;\n"
+                         "    }\n"
+                         "    return nullptr;\n"
+                         "}\n");
+    
+    os << "// Generated by --emit-cpp. Build against the interpreter's runtime:\n"
+       << "//     g++ -std=c++17 -O2 -pthread -I<src> program.cpp <src>/Value.cpp\n"
+       << kRuntime;
+    for (auto& paragraph : paragraphs) {
+        if (!paragraph.empty()) os << '\n' << paragraph;
+    }
+    os << "\n} // namespace\n\nint main() {\n"
+       << "    std::ios::sync_with_stdio(false);\n"
+       << "    pthread_attr_t attr;\n"
+       << "    pthread_t thread;\n"
+       << "    pthread_attr_init(&attr);\n"
+       << "    pthread_attr_setstacksize(&attr, kStackSize);\n"
+       << "    if (pthread_create(&thread, &attr, run, nullptr) == 0) pthread_join(thread, nullptr);\n"
+       << "    else run(nullptr);\n"
+       << "    return 0;\n"
+       << "}\n";
+}
+
+// Statements
+void CppEmitter::emitFunction(int number, std::string& text) {
+    emitBody(number, false, text);
+    if (intParams.count(number)) {
+        text += '\n';
+        emitBody(number, true, text);
+    }
+}
+
+// The generic body hands Int arguments to the variant; a call of the function
+// itself from its tail jumps back to tail_call
+void CppEmitter::emitBody(int number, bool variant, std::string& text) {
+    auto& def = *definitions[number - 1];
+    auto it = intParams.find(number);
+    inferLocals(def, variant ? it->second : std::vector<bool>(def.params.size()));
+    function = number;
+    inVariant = variant;
+    inFunction = true;
+    tailCalled = false;
+    indent = 1;
+    nextTemp = 0;
+    std::string body;
+    out = &body;
+    emitBlock(def.body);
+    if (def.body.empty() || def.body.back()->kind != Stmt::Kind::Return) line("return Value();");
+    
+    out = &text;
+    text += signature(number, variant) + " {\n";
+    if (!variant && it != intParams.end()) {
+        std::string test;
+        std::string args;
+        for (size_t p = 0; p < def.params.size(); p++) {
+            std::string param = variable(def.params[p]);
+            if (p > 0) args += ", ";
+            if (it->second[p]) {
+                if (!test.empty()) test += " && ";
+                test += param + ".type == Value::INT";
+                args += "Int(" + param + ".intVal)";
+            } else {
+                args += "std::move(" + param + ")";
+            }
+        }
+        line("if (" + test + ") return " + functionName(number, true) + "(" + args + ");");
+    }
+    line("Frame frame;");
+    for (auto& [name, type] : locals) {
+        if (std::find(def.params.begin(), def.params.end(), name) != def.params.end()) continue;
+        switch (type) {
+            case Type::Int: line("Int " + variable(name) + ";"); break;
+            case Type::Double: line("double " + variable(name) + " = 0;"); break;
+            case Type::Bool: line("bool " + variable(name) + " = false;"); break;
+            default: line("Value " + variable(name) + ";"); break;
+        }
+    }
+    if (tailCalled) text += "tail_call:\n";
+    text += body;
+    text += "}\n";
+    inFunction = false;
+}
+
+void CppEmitter::emitBlock(const Block& block) {
+    for (auto& stmt : block) {
+        emitStmt(*stmt);
+    }
+}
+
+void CppEmitter::emitStmt(const Stmt& stmt) {
+    switch (stmt.kind) {
+        case Stmt::Kind::Expr: {
+            Code code = emitExpr(*static_cast<const ExprStmt&>(stmt).expr);
+            if (!code.stable) line("(void)" + code.text + ";");
+            break;
+        }
+        case Stmt::Kind::Assign:
+            emitAssign(static_cast<const AssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::AugAssign:
+            emitAugAssign(static_cast<const AugAssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::If:
+            emitIf(static_cast<const IfStmt&>(stmt));
+            break;
+        case Stmt::Kind::While:
+            emitWhile(static_cast<const WhileStmt&>(stmt));
+            break;
+        case Stmt::Kind::Break:
+            // break and continue outside a loop have nothing to leave
+            if (loopDepth > 0) line("break;");
+            break;
+        case Stmt::Kind::Continue:
+            if (loopDepth > 0) line("continue;");
+            break;
+        case Stmt::Kind::Return: {
+            // A return in top-level code ends the program
+            auto& ret = static_cast<const ReturnStmt&>(stmt);
+            if (inFunction && ret.value && ret.value->kind == Expr::Kind::Call) {
+                auto& call = static_cast<const CallExpr&>(*ret.value);
+                if (call.builtin == Builtin::None && definitionsOf.count(call.function)) {
+                    emitCall(call, true);
+                    break;
+                }
+            }
+            Code value{"Value()", Type::Boxed, true};
+            if (ret.value) value = emitExpr(*ret.value);
+            if (inFunction) {
+                line("return " + unparen(boxed(value)) + ";");
+            } else {
+                if (!value.stable) line("(void)" + value.text + ";");
+                line("return false;");
+            }
+            break;
+        }
+        case Stmt::Kind::FunctionDef:
+            emitFunctionDef(static_cast<const FunctionDefStmt&>(stmt));
+            break;
+    }
+}
+
+void CppEmitter::emitAssign(const AssignStmt& stmt) {
+    // Parallel assignment a, b = x, y stores the elements without building a
+    // tuple; elements that read a target are saved before the first store
+    if (stmt.targets.size() == 1 && stmt.value->kind == Expr::Kind::Tuple) {
+        auto& elements = static_cast<const TupleExpr&>(*stmt.value).elements;
+        auto& names = stmt.targets[0];
+        if (names.size() == elements.size()) {
+            std::vector<const Expr*> operands;
+            for (auto& element : elements) {
+                operands.push_back(element.get());
+            }
+            std::vector<Code> values = emitOperands(operands);
+            for (size_t j = 0; j < values.size(); j++) {
+                bool readsTarget = std::any_of(names.begin(), names.end(),
+                    [&](const std::string& name) { return !name.empty() && reads(*operands[j], name); });
+                if (readsTarget && !values[j].temporary) values[j] = materialize(values[j]);
+            }
+            for (size_t j = 0; j < names.size(); j++) {
+                if (!names[j].empty()) store(names[j], values[j], false);
+            }
+            return;
+        }
+    }
+    
+    // x = x op y updates a boxed x in place, as long as nothing in y can
+    // change x or read it
+    if (stmt.targets.size() == 1 && stmt.targets[0].size() == 1 && stmt.value->kind == Expr::Kind::Binary) {
+        auto& name = stmt.targets[0][0];
+        auto& binary = static_cast<const BinaryExpr&>(*stmt.value);
+        bool sameVariable = binary.left->kind == Expr::Kind::Name &&
+                            static_cast<const NameExpr&>(*binary.left).name == name &&
+                            (locals.count(name) || !functionNames.count(name));
+        if (!name.empty() && sameVariable && binary.op != BinaryOp::Div &&
+            typeOf(*binary.left) == Type::Boxed && typeOf(binary) == Type::Boxed &&
+            !reads(*binary.right, name) && !hasEffects(*binary.right)) {
+            Code target{variable(name), Type::Boxed, true};
+            Code right = emitExpr(*binary.right);
+            store(name, this->binary(binary.op, target, *binary.left, right, *binary.right, true), false);
+            return;
+        }
+    }
+    
+    Code value = emitExpr(*stmt.value);
+    if (stmt.targets.size() == 1 && stmt.targets[0].size() == 1) {
+        if (!stmt.targets[0][0].empty()) store(stmt.targets[0][0], value, false);
+        else if (!value.stable) line("(void)" + value.text + ";");
+        return;
+    }
+    // Every target gets the same value, so it is computed once
+    if (!value.temporary) value = materialize(value);
+    for (auto& names : stmt.targets) {
+        if (names.size() == 1) {
+            if (!names[0].empty()) store(names[0], value, true);
+            continue;
+        }
+        std::string targets;
+        for (size_t j = 0; j < names.size(); j++) {
+            if (j > 0) targets += ", ";
+            targets += names[j].empty() ? "nullptr" : "&" + variable(names[j]);
+        }
+        line("unpack(" + boxed(value) + ", {" + targets + "});");
+    }
+}
+
+void CppEmitter::emitAugAssign(const AugAssignStmt& stmt) {
+    // The value is computed before the target is read, as the VM does
+    Code value = emitExpr(*stmt.value);
+    bool readsTarget = std::any_of(stmt.targets.begin(), stmt.targets.end(),
+        [&](const std::string& name) { return !name.empty() && reads(*stmt.value, name); });
+    if (!value.temporary && (readsTarget || (stmt.targets.size() > 1 && !value.stable))) value = materialize(value);
+    
+    for (auto& name : stmt.targets) {
+        if (name.empty()) continue;
+        auto it = locals.find(name);
+        Type type = it == locals.end() ? Type::Boxed : it->second;
+        NameExpr target(name);
+        Code current{variable(name), type, true};
+        store(name, binary(stmt.op, current, target, value, *stmt.value, type == Type::Boxed), true);
+    }
+}
+
+void CppEmitter::emitIf(const IfStmt& stmt) {
+    // An elif whose condition needs statements of its own nests in an else
+    int nested = 0;
+    Code condition = emitExpr(*stmt.conditions[0]);
+    line("if (" + unparen(truth(condition)) + ") {");
+    for (size_t i = 0; i < stmt.conditions.size(); i++) {
+        indent++;
+        emitBlock(stmt.branches[i]);
+        indent--;
+        if (i + 1 == stmt.conditions.size()) break;
+        
+        std::string prelude;
+        indent++;
+        Code next = capture(*stmt.conditions[i + 1], prelude);
+        indent--;
+        if (prelude.empty()) {
+            line("} else if (" + unparen(truth(next)) + ") {");
+        } else {
+            line("} else {");
+            *out += prelude;
+            indent++;
+            nested++;
+            line("if (" + unparen(truth(next)) + ") {");
+        }
+    }
+    if (!stmt.orelse.empty()) {
+        line("} else {");
+        indent++;
+        emitBlock(stmt.orelse);
+        indent--;
+    }
+    line("}");
+    while (nested-- > 0) {
+        indent--;
+        line("}");
+    }
+}
+
+void CppEmitter::emitWhile(const WhileStmt& stmt) {
+    // A condition that needs statements of its own is tested inside the
+    // loop, so continue evaluates it again
+    std::string prelude;
+    indent++;
+    Code condition = capture(*stmt.condition, prelude);
+    if (prelude.empty()) {
+        indent--;
+        line("while (" + unparen(truth(condition)) + ") {");
+    } else {
+        indent--;
+        line("while (true) {");
+        *out += prelude;
+        indent++;
+        line("if (!(" + unparen(truth(condition)) + ")) break;");
+        indent--;
+    }
+    loopDepth++;
+    indent++;
+    emitBlock(stmt.body);
+    indent--;
+    loopDepth--;
+    line("}");
+}
+
+void CppEmitter::emitFunctionDef(const FunctionDefStmt& stmt) {
+    // Defaults are evaluated where the def runs
+    int number = std::find(definitions.begin(), definitions.end(), &stmt) - definitions.begin() + 1;
+    std::vector<const Expr*> defaults;
+    for (auto& def : stmt.defaults) {
+        defaults.push_back(def.get());
+    }
+    std::vector<Code> values = emitOperands(defaults);
+    for (size_t i = 0; i < values.size(); i++) {
+        line("defaults" + std::to_string(number) + "[" + std::to_string(i) + "] = " + unparen(argument(values[i])) + ";");
+    }
+    line("bound_" + mangle((*slotNames)[stmt.function]) + " = " + std::to_string(number) + ";");
+}
+
+void CppEmitter::store(const std::string& name, const Code& value, bool keep) {
+    auto it = locals.find(name);
+    Type type = it == locals.end() ? Type::Boxed : it->second;
+    std::string text = type != Type::Boxed ? convert(value, type) : keep ? boxed(value) : argument(value);
+    line(variable(name) + " = " + unparen(text) + ";");
+}
+
+// Expressions
+CppEmitter::Code CppEmitter::emitExpr(const Expr& expr) {
+    switch (expr.kind) {
+        case Expr::Kind::Constant: {
+            auto& value = static_cast<const ConstantExpr&>(expr).value;
+            long long n;
+            switch (typeOf(expr)) {
+                case Type::Int:
+                    isSmallInt(value, n);
+                    return {"Int(" + std::to_string(n) + ")", Type::Int, true, false, &value};
+                case Type::Double: return {doubleLiteral(value.floatVal), Type::Double, true};
+                case Type::Bool: return {value.boolVal ? "true" : "false", Type::Bool, true};
+                default: return {constant(value), Type::Boxed, true};
+            }
+        }
+        case Expr::Kind::Name: {
+            // A function name evaluates to its name as a string
+            auto& name = static_cast<const NameExpr&>(expr).name;
+            auto it = locals.find(name);
+            if (it != locals.end()) return {variable(name), it->second, true};
+            if (functionNames.count(name)) return {constant(Value(name)), Type::Boxed, true};
+            return {variable(name), Type::Boxed, false};
+        }
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<const UnaryExpr&>(expr);
+            Code operand = emitExpr(*unary.operand);
+            if (unary.op == UnaryOp::Not) return {"!" + truth(operand), Type::Bool};
+            if (operand.type == Type::Double || operand.type == Type::Int) return {"(-" + operand.text + ")", operand.type};
+            return {"(-" + boxed(operand) + ")", Type::Boxed};
+        }
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            std::vector<Code> operands = emitOperands({binary.left.get(), binary.right.get()});
+            return this->binary(binary.op, operands[0], *binary.left, operands[1], *binary.right, false);
+        }
+        case Expr::Kind::Compare:
+            return emitCompare(static_cast<const CompareExpr&>(expr));
+        case Expr::Kind::Logical:
+            return emitLogical(static_cast<const LogicalExpr&>(expr));
+        case Expr::Kind::Call:
+            return emitCall(static_cast<const CallExpr&>(expr), false);
+        case Expr::Kind::Tuple: {
+            std::vector<const Expr*> elements;
+            for (auto& element : static_cast<const TupleExpr&>(expr).elements) {
+                elements.push_back(element.get());
+            }
+            std::string text;
+            for (auto& element : emitOperands(elements)) {
+                if (!text.empty()) text += ", ";
+                text += unparen(argument(element));
+            }
+            return {"makeTuple(" + text + ")", Type::Boxed};
+        }
+        case Expr::Kind::FString: {
+            std::vector<const Expr*> parts;
+            for (auto& part : static_cast<const FStringExpr&>(expr).parts) {
+                if (part.expr) parts.push_back(part.expr.get());
+            }
+            std::vector<Code> values = emitOperands(parts);
+            std::string text;
+            size_t next = 0;
+            for (auto& part : static_cast<const FStringExpr&>(expr).parts) {
+                if (!text.empty()) text += ", ";
+                text += part.expr ? unparen(values[next++].text) : constant(Value(part.literal));
+            }
+            return {"format(" + text + ")", Type::Boxed};
+        }
+    }
+    return {"Value()", Type::Boxed, true};
+}
+
+CppEmitter::Code CppEmitter::binary(BinaryOp op, const Code& left, const Expr& leftExpr,
+                                    const Code& right, const Expr& rightExpr, bool reuseLeft) {
+    std::string symbol = binarySymbol(op);
+    Type type = binaryType(op, left.type, leftExpr, right.type, rightExpr);
+    if (type == Type::Double) {
+        return {"(" + asDouble(left, leftExpr) + " " + symbol + " " + asDouble(right, rightExpr) + ")", Type::Double};
+    }
+    if (type == Type::Int) {
+        if (op == BinaryOp::FloorDiv) return {"floordiv(" + left.text + ", " + right.text + ")", Type::Int};
+        return {"(" + left.text + " " + symbol + " " + right.text + ")", Type::Int};
+    }
+    // The && operators of Value reuse a moved left operand's storage; a
+    // temporary is only read once
+    std::string l = reuseLeft ? "std::move(" + left.text + ")" : argument(left);
+    if (op == BinaryOp::FloorDiv) return {l + ".floordiv(" + unparen(boxed(right)) + ")", Type::Boxed};
+    return {"(" + l + " " + symbol + " " + boxed(right) + ")", Type::Boxed};
+}
+
+CppEmitter::Code CppEmitter::emitCompare(const CompareExpr& expr) {
+    // A chain is its links joined by and: each operand is evaluated at most
+    // once, and not at all after a false link. Names and constants past the
+    // first link cost nothing to read, so those chains are joined by &&
+    std::vector<const Expr*> operands;
+    for (auto& operand : expr.operands) {
+        operands.push_back(operand.get());
+    }
+    bool cheap = std::all_of(operands.begin() + 2, operands.end(), [](const Expr* operand) {
+        return operand->kind == Expr::Kind::Name || operand->kind == Expr::Kind::Constant;
+    });
+    if (cheap) {
+        std::vector<Code> values = emitOperands(operands);
+        if (expr.ops.size() == 1) {
+            return {compare(expr.ops[0], values[0], *operands[0], values[1], *operands[1]), Type::Bool};
+        }
+        for (size_t i = 1; i + 1 < values.size(); i++) {
+            if (!values[i].stable) values[i] = materialize(values[i]);
+        }
+        std::string text;
+        for (size_t i = 0; i < expr.ops.size(); i++) {
+            if (i > 0) text += " && ";
+            text += compare(expr.ops[i], values[i], *operands[i], values[i + 1], *operands[i + 1]);
+        }
+        return {"(" + text + ")", Type::Bool};
+    }
+    
+    Code result{temp(), Type::Bool, true, true};
+    std::vector<Code> values = emitOperands({operands[0], operands[1]});
+    Code left = values[0];
+    Code right = values[1].stable ? values[1] : materialize(values[1]);
+    line("bool " + result.text + " = " + unparen(compare(expr.ops[0], left, *operands[0], right, *operands[1])) + ";");
+    for (size_t i = 1; i < expr.ops.size(); i++) {
+        line("if (" + result.text + ") {");
+        indent++;
+        left = right;
+        right = emitExpr(*operands[i + 1]);
+        if (i + 1 < expr.ops.size() && !right.stable) right = materialize(right);
+        line(result.text + " = " + unparen(compare(expr.ops[i], left, *operands[i], right, *operands[i + 1])) + ";");
+    }
+    for (size_t i = 1; i < expr.ops.size(); i++) {
+        indent--;
+        line("}");
+    }
+    return result;
+}
+
+std::string CppEmitter::compare(CompareOp op, const Code& left, const Expr& leftExpr,
+                                const Code& right, const Expr& rightExpr) {
+    if (left.type == Type::Int && right.type == Type::Int) {
+        return "(" + left.text + " " + compareSymbol(op) + " " + right.text + ")";
+    }
+    if (!compareNumerically(left.type, leftExpr, right.type, rightExpr)) {
+        return "(" + boxed(left) + " " + compareSymbol(op) + " " + boxed(right) + ")";
+    }
+    // Value derives <= and >= from <, which differs from them for NaN
+    std::string l = asDouble(left, leftExpr);
+    std::string r = asDouble(right, rightExpr);
+    switch (op) {
+        case CompareOp::Le: return "!(" + l + " > " + r + ")";
+        case CompareOp::Ge: return "!(" + l + " < " + r + ")";
+        default: return "(" + l + " " + compareSymbol(op) + " " + r + ")";
+    }
+}
+
+CppEmitter::Code CppEmitter::emitLogical(const LogicalExpr& expr) {
+    // The result is the last operand evaluated, so each later operand is
+    // evaluated under the test of the one before
+    Type type = typeOf(expr);
+    Code result{temp(), type, true, true};
+    Code first = emitExpr(*expr.operands[0]);
+    line(typeName(type) + " " + result.text + " = " + unparen(type == Type::Boxed ? argument(first) : convert(first, type)) + ";");
+    for (size_t i = 1; i < expr.operands.size(); i++) {
+        std::string test = truth(result);
+        line("if (" + (expr.op == LogicalOp::And ? test : "!" + test) + ") {");
+        indent++;
+        Code next = emitExpr(*expr.operands[i]);
+        line(result.text + " = " + unparen(type == Type::Boxed ? argument(next) : convert(next, type)) + ";");
+    }
+    for (size_t i = 1; i < expr.operands.size(); i++) {
+        indent--;
+        line("}");
+    }
+    return result;
+}
+
+CppEmitter::Code CppEmitter::emitCall(const CallExpr& expr, bool tail) {
+    std::vector<const Expr*> args;
+    for (auto& arg : expr.args) {
+        args.push_back(arg.value.get());
+    }
+    
+    // Built-in functions
+    if (expr.builtin == Builtin::Print) {
+        std::string text;
+        for (auto& value : emitOperands(args)) {
+            if (!text.empty()) text += ", ";
+            text += unparen(value.text);
+        }
+        line("print(" + text + ");");
+        return {"Value()", Type::Boxed, true};
+    }
+    if (expr.builtin != Builtin::None) {
+        // Only the first argument is evaluated
+        Code arg = args.empty() ? Code{"Value()", Type::Boxed, true} : emitExpr(*args[0]);
+        switch (expr.builtin) {
+            case Builtin::Float:
+                return {args.empty() ? doubleLiteral(0.0) : asDouble(arg, *args[0]), Type::Double};
+            case Builtin::Bool:
+                return {truth(arg), Type::Bool};
+            case Builtin::Int:
+                if (arg.type == Type::Int) return arg;
+                return {"Int(" + boxed(arg) + ".toInt())", Type::Int};
+            default:
+                return {"applyConversion(Builtin::Str, " + unparen(boxed(arg)) + ")", Type::Boxed};
+        }
+    }
+    
+    // Without a user function of that name the call evaluates its atom
+    std::vector<Code> values = emitOperands(args);
+    auto it = definitionsOf.find(expr.function);
+    if (it == definitionsOf.end()) {
+        for (auto& value : values) {
+            if (!value.stable) line("(void)" + value.text + ";");
+        }
+        return emitExpr(*expr.atom);
+    }
+    
+    // Arguments are bound against each def of the name the way
+    // VM::bindCallSite binds them. A tail call returns the callee's result
+    // in place of the caller's frame, the way VM's TailCall does
+    Code result{temp(), Type::Boxed, true, true};
+    if (!tail) line("Value " + result.text + ";");
+    std::string slot = "bound_" + mangle((*slotNames)[expr.function]);
+    for (size_t k = 0; k < it->second.size(); k++) {
+        int number = it->second[k];
+        std::vector<int> bound = bindArguments(*definitions[number - 1], expr);
+        line((k == 0 ? "if (" : "} else if (") + slot + " == " + std::to_string(number) + ") {");
+        indent++;
+        if (tail && number == function && (!inVariant || takesInts(number, bound, values))) {
+            emitSelfTailCall(expr, bound, values);
+        } else if (tail) {
+            line("TailCall tail;");
+            line("return " + callText(number, bound, values) + ";");
+        } else {
+            line(result.text + " = " + callText(number, bound, values) + ";");
+        }
+        indent--;
+    }
+    line("} else {");
+    indent++;
+    Code atom = emitExpr(*expr.atom);
+    line((tail ? "return " : result.text + " = ") + unparen(argument(atom)) + ";");
+    indent--;
+    line("}");
+    return result;
+}
+
+// The argument bound to each parameter of def, or -1; a later argument for a
+// parameter wins
+std::vector<int> CppEmitter::bindArguments(const FunctionDefStmt& def, const CallExpr& expr) {
+    std::vector<int> bound(def.params.size(), -1);
+    size_t positional = 0;
+    for (size_t i = 0; i < expr.args.size(); i++) {
+        int param = -1;
+        if (!expr.args[i].keyword.empty()) {
+            auto found = std::find(def.params.begin(), def.params.end(), expr.args[i].keyword);
+            if (found != def.params.end()) param = found - def.params.begin();
+        } else if (positional < def.params.size()) {
+            param = positional++;
+        }
+        if (param >= 0) bound[param] = i;
+    }
+    return bound;
+}
+
+// Whether the call can go straight to the def's Int variant
+bool CppEmitter::takesInts(int number, const std::vector<int>& bound, const std::vector<Code>& values) const {
+    auto it = intParams.find(number);
+    if (it == intParams.end()) return false;
+    for (size_t p = 0; p < bound.size(); p++) {
+        if (it->second[p] && (bound[p] < 0 || values[bound[p]].type != Type::Int)) return false;
+    }
+    return true;
+}
+
+std::string CppEmitter::callText(int number, const std::vector<int>& bound, const std::vector<Code>& values) {
+    auto& def = *definitions[number - 1];
+    bool ints = takesInts(number, bound, values);
+    size_t defaultStart = def.params.size() - def.defaults.size();
+    std::string args;
+    for (size_t p = 0; p < def.params.size(); p++) {
+        if (p > 0) args += ", ";
+        if (bound[p] >= 0) args += unparen(ints && intParams[number][p] ? values[bound[p]].text : argument(values[bound[p]]));
+        else if (p >= defaultStart) args += "defaults" + std::to_string(number) + "[" + std::to_string(p - defaultStart) + "]";
+        else args += "Value()";
+    }
+    return functionName(number, ints) + "(" + args + ")";
+}
+
+// Rebinds the parameters and jumps back to the top of the body; a value
+// that reads a parameter assigned before it is saved first, and boxed locals
+// go back to None
+void CppEmitter::emitSelfTailCall(const CallExpr& expr, const std::vector<int>& bound, const std::vector<Code>& values) {
+    auto& def = *definitions[function - 1];
+    size_t defaultStart = def.params.size() - def.defaults.size();
+    std::vector<Code> params;
+    for (size_t p = 0; p < def.params.size(); p++) {
+        if (bound[p] < 0) {
+            std::string value = p >= defaultStart ? "defaults" + std::to_string(function) + "[" + std::to_string(p - defaultStart) + "]" : "Value()";
+            params.push_back({value, Type::Boxed, true});
+            continue;
+        }
+        Code value = values[bound[p]];
+        auto& arg = *expr.args[bound[p]].value;
+        bool readsEarlier = std::any_of(def.params.begin(), def.params.begin() + p,
+            [&](const std::string& name) { return reads(arg, name); });
+        if (readsEarlier && !value.temporary) value = materialize(value);
+        params.push_back(value);
+    }
+    for (size_t p = 0; p < def.params.size(); p++) {
+        std::string param = variable(def.params[p]);
+        if (params[p].text == param) continue;
+        line(param + " = " + unparen(locals[def.params[p]] == Type::Int ? params[p].text : argument(params[p])) + ";");
+    }
+    for (auto& [name, type] : locals) {
+        bool isParam = std::find(def.params.begin(), def.params.end(), name) != def.params.end();
+        if (!isParam && type == Type::Boxed) line(variable(name) + " = Value();");
+    }
+    line("goto tail_call;");
+    tailCalled = true;
+}
+
+// Emits the operands in order; operands before the last one that can call a
+// user function are saved first, since the call may change what they read
+std::vector<CppEmitter::Code> CppEmitter::emitOperands(const std::vector<const Expr*>& operands) {
+    int last = -1;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (hasEffects(*operands[i])) last = i;
+    }
+    std::vector<Code> values;
+    for (size_t i = 0; i < operands.size(); i++) {
+        Code value = emitExpr(*operands[i]);
+        if (int(i) < last && !value.stable) value = materialize(value);
+        values.push_back(std::move(value));
+    }
+    return values;
+}
+
+// Emits the expression's statements into prelude instead of the output
+CppEmitter::Code CppEmitter::capture(const Expr& expr, std::string& prelude) {
+    std::string* saved = out;
+    out = &prelude;
+    Code code = emitExpr(expr);
+    out = saved;
+    return code;
+}
+
+CppEmitter::Code CppEmitter::materialize(const Code& code) {
+    Code saved{temp(), code.type, true, true};
+    line(typeName(code.type) + " " + saved.text + " = " + unparen(code.text) + ";");
+    return saved;
+}
+
+// Typing
+// Infers the types of the function's locals: a local is a candidate when its
+// first use is an unconditional assignment of it alone, so it is never read
+// before it holds a value of its type. Candidates start Unknown and are
+// joined with the types of their assignments until nothing changes; those
+// still Unknown, which are only assigned from each other, become Boxed and
+// the others are joined again.
+void CppEmitter::inferLocals(const FunctionDefStmt& def, const std::vector<bool>& ints) {
+    locals.clear();
+    for (size_t p = 0; p < def.params.size(); p++) {
+        locals[def.params[p]] = ints[p] ? Type::Int : Type::Boxed;
+    }
+    std::set<std::string> assigned;
+    collectAssigned(def.body, assigned);
+    std::set<std::string> seen;
+    std::set<std::string> clean;
+    firstUses(def.body, true, seen, clean);
+    for (auto& name : assigned) {
+        if (globalNames.count(name) || locals.count(name)) continue;
+        locals[name] = clean.count(name) ? Type::Unknown : Type::Boxed;
+    }
+    
+    bool unknown = true;
+    while (unknown) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            inferBlock(def.body, changed);
+        }
+        unknown = false;
+        for (auto& [name, type] : locals) {
+            if (type == Type::Unknown) {
+                type = Type::Boxed;
+                unknown = true;
+            }
+        }
+    }
+}
+
+void CppEmitter::inferBlock(const Block& block, bool& changed) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Assign: {
+                auto& assign = static_cast<const AssignStmt&>(*stmt);
+                bool parallel = assign.targets.size() == 1 && assign.value->kind == Expr::Kind::Tuple &&
+                                static_cast<const TupleExpr&>(*assign.value).elements.size() == assign.targets[0].size();
+                for (auto& names : assign.targets) {
+                    for (size_t j = 0; j < names.size(); j++) {
+                        Type type = Type::Boxed;
+                        if (parallel) type = typeOf(*static_cast<const TupleExpr&>(*assign.value).elements[j]);
+                        else if (names.size() == 1) type = typeOf(*assign.value);
+                        refine(names[j], type, changed);
+                    }
+                }
+                break;
+            }
+            case Stmt::Kind::AugAssign: {
+                auto& aug = static_cast<const AugAssignStmt&>(*stmt);
+                for (auto& name : aug.targets) {
+                    auto it = locals.find(name);
+                    if (it == locals.end()) continue;
+                    NameExpr target(name);
+                    refine(name, binaryType(aug.op, it->second, target, typeOf(*aug.value), *aug.value), changed);
+                }
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    inferBlock(branch, changed);
+                }
+                inferBlock(ifStmt.orelse, changed);
+                break;
+            }
+            case Stmt::Kind::While:
+                inferBlock(static_cast<const WhileStmt&>(*stmt).body, changed);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void CppEmitter::refine(const std::string& name, Type type, bool& changed) {
+    auto it = locals.find(name);
+    if (it == locals.end()) return;
+    Type joined = join(it->second, type);
+    if (joined != it->second) {
+        it->second = joined;
+        changed = true;
+    }
+}
+
+CppEmitter::Type CppEmitter::typeOf(const Expr& expr) const {
+    switch (expr.kind) {
+        case Expr::Kind::Constant: {
+            auto& value = static_cast<const ConstantExpr&>(expr).value;
+            long long n;
+            if (isSmallInt(value, n)) return Type::Int;
+            if (value.type == Value::FLOAT && std::isfinite(value.floatVal)) return Type::Double;
+            return value.type == Value::BOOL ? Type::Bool : Type::Boxed;
+        }
+        case Expr::Kind::Name: {
+            auto it = locals.find(static_cast<const NameExpr&>(expr).name);
+            return it == locals.end() ? Type::Boxed : it->second;
+        }
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<const UnaryExpr&>(expr);
+            if (unary.op == UnaryOp::Not) return Type::Bool;
+            Type operand = typeOf(*unary.operand);
+            return operand == Type::Int || operand == Type::Double || operand == Type::Unknown ? operand : Type::Boxed;
+        }
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            return binaryType(binary.op, typeOf(*binary.left), *binary.left, typeOf(*binary.right), *binary.right);
+        }
+        case Expr::Kind::Compare:
+            return Type::Bool;
+        case Expr::Kind::Logical: {
+            Type type = Type::Unknown;
+            for (auto& operand : static_cast<const LogicalExpr&>(expr).operands) {
+                type = join(type, typeOf(*operand));
+            }
+            return type;
+        }
+        case Expr::Kind::Call: {
+            Builtin builtin = static_cast<const CallExpr&>(expr).builtin;
+            if (builtin == Builtin::Int) return Type::Int;
+            if (builtin == Builtin::Float) return Type::Double;
+            return builtin == Builtin::Bool ? Type::Bool : Type::Boxed;
+        }
+        case Expr::Kind::Tuple:
+        case Expr::Kind::FString:
+            return Type::Boxed;
+    }
+    return Type::Boxed;
+}
+
+// Value takes +, - and * to float arithmetic when either operand is a float
+// and the other an int, float or bool, and keeps ints with ints; / is always
+// float division, and // and % are int arithmetic only on two ints
+CppEmitter::Type CppEmitter::binaryType(BinaryOp op, Type left, const Expr& leftExpr, Type right, const Expr& rightExpr) {
+    if (op == BinaryOp::Div) return Type::Double;
+    bool integral = op == BinaryOp::FloorDiv || op == BinaryOp::Mod;
+    bool leftNumeric = left == Type::Unknown || (integral ? left == Type::Int : numeric(left, leftExpr));
+    bool rightNumeric = right == Type::Unknown || (integral ? right == Type::Int : numeric(right, rightExpr));
+    if (!leftNumeric || !rightNumeric) return Type::Boxed;
+    if (left == Type::Double || right == Type::Double) return Type::Double;
+    if (left == Type::Unknown || right == Type::Unknown) return Type::Unknown;
+    return left == Type::Int && right == Type::Int ? Type::Int : Type::Boxed;
+}
+
+bool CppEmitter::numeric(Type type, const Expr& expr) {
+    return type == Type::Int || type == Type::Double || type == Type::Bool || isIntConstant(expr);
+}
+
+bool CppEmitter::compareNumerically(Type left, const Expr& leftExpr, Type right, const Expr& rightExpr) {
+    return (left == Type::Double && numeric(right, rightExpr)) || (right == Type::Double && numeric(left, leftExpr));
+}
+
+CppEmitter::Type CppEmitter::join(Type left, Type right) {
+    if (left == Type::Unknown) return right;
+    if (right == Type::Unknown || left == right) return left;
+    return Type::Boxed;
+}
+
+// Records the names in a block in order of first use; clean ones are first
+// used by a top-level assignment of that name alone
+void CppEmitter::firstUses(const Block& block, bool topLevel, std::set<std::string>& seen, std::set<std::string>& clean) {
+    for (auto& stmt : block) {
+        if (topLevel && stmt->kind == Stmt::Kind::Assign) {
+            auto& assign = static_cast<const AssignStmt&>(*stmt);
+            if (assign.targets.size() == 1 && assign.targets[0].size() == 1 && !assign.targets[0][0].empty()) {
+                markNames(*assign.value, seen);
+                if (seen.insert(assign.targets[0][0]).second) clean.insert(assign.targets[0][0]);
+                continue;
+            }
+        }
+        markNames(*stmt, seen);
+    }
+}
+
+void CppEmitter::markNames(const Stmt& stmt, std::set<std::string>& seen) {
+    switch (stmt.kind) {
+        case Stmt::Kind::Expr:
+            markNames(*static_cast<const ExprStmt&>(stmt).expr, seen);
+            break;
+        case Stmt::Kind::Assign: {
+            auto& assign = static_cast<const AssignStmt&>(stmt);
+            markNames(*assign.value, seen);
+            for (auto& names : assign.targets) {
+                seen.insert(names.begin(), names.end());
+            }
+            break;
+        }
+        case Stmt::Kind::AugAssign: {
+            auto& aug = static_cast<const AugAssignStmt&>(stmt);
+            markNames(*aug.value, seen);
+            seen.insert(aug.targets.begin(), aug.targets.end());
+            break;
+        }
+        case Stmt::Kind::If: {
+            auto& ifStmt = static_cast<const IfStmt&>(stmt);
+            for (size_t i = 0; i < ifStmt.conditions.size(); i++) {
+                markNames(*ifStmt.conditions[i], seen);
+                std::set<std::string> clean;
+                firstUses(ifStmt.branches[i], false, seen, clean);
+            }
+            std::set<std::string> clean;
+            firstUses(ifStmt.orelse, false, seen, clean);
+            break;
+        }
+        case Stmt::Kind::While: {
+            auto& whileStmt = static_cast<const WhileStmt&>(stmt);
+            markNames(*whileStmt.condition, seen);
+            std::set<std::string> clean;
+            firstUses(whileStmt.body, false, seen, clean);
+            break;
+        }
+        case Stmt::Kind::Return: {
+            auto& ret = static_cast<const ReturnStmt&>(stmt);
+            if (ret.value) markNames(*ret.value, seen);
+            break;
+        }
+        case Stmt::Kind::FunctionDef:
+            // The body is a scope of its own; the defaults belong to this one
+            for (auto& value : static_cast<const FunctionDefStmt&>(stmt).defaults) {
+                markNames(*value, seen);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void CppEmitter::markNames(const Expr& expr, std::set<std::string>& seen) {
+    if (expr.kind == Expr::Kind::Name) seen.insert(static_cast<const NameExpr&>(expr).name);
+    forEachChild(expr, [&](const Expr& child) { markNames(child, seen); });
+}
+
+// Whether evaluating the expression can run user code or print
+bool CppEmitter::hasEffects(const Expr& expr) {
+    if (expr.kind == Expr::Kind::Call) {
+        Builtin builtin = static_cast<const CallExpr&>(expr).builtin;
+        if (builtin == Builtin::None || builtin == Builtin::Print) return true;
+    }
+    bool effects = false;
+    forEachChild(expr, [&](const Expr& child) { effects = effects || hasEffects(child); });
+    return effects;
+}
+
+bool CppEmitter::reads(const Expr& expr, const std::string& name) {
+    if (expr.kind == Expr::Kind::Name) return static_cast<const NameExpr&>(expr).name == name;
+    bool found = false;
+    forEachChild(expr, [&](const Expr& child) { found = found || reads(child, name); });
+    return found;
+}
+
+// Names used directly as operands of arithmetic or comparisons
+void CppEmitter::collectOperands(const Block& block, std::set<std::string>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Expr:
+                collectOperands(*static_cast<const ExprStmt&>(*stmt).expr, out);
+                break;
+            case Stmt::Kind::Assign:
+                collectOperands(*static_cast<const AssignStmt&>(*stmt).value, out);
+                break;
+            case Stmt::Kind::AugAssign: {
+                auto& aug = static_cast<const AugAssignStmt&>(*stmt);
+                out.insert(aug.targets.begin(), aug.targets.end());
+                if (aug.value->kind == Expr::Kind::Name) out.insert(static_cast<const NameExpr&>(*aug.value).name);
+                collectOperands(*aug.value, out);
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (size_t i = 0; i < ifStmt.conditions.size(); i++) {
+                    collectOperands(*ifStmt.conditions[i], out);
+                    collectOperands(ifStmt.branches[i], out);
+                }
+                collectOperands(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While: {
+                auto& whileStmt = static_cast<const WhileStmt&>(*stmt);
+                collectOperands(*whileStmt.condition, out);
+                collectOperands(whileStmt.body, out);
+                break;
+            }
+            case Stmt::Kind::Return: {
+                auto& ret = static_cast<const ReturnStmt&>(*stmt);
+                if (ret.value) collectOperands(*ret.value, out);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+void CppEmitter::collectOperands(const Expr& expr, std::set<std::string>& out) {
+    bool arithmetic = expr.kind == Expr::Kind::Binary || expr.kind == Expr::Kind::Compare ||
+                      (expr.kind == Expr::Kind::Unary && static_cast<const UnaryExpr&>(expr).op == UnaryOp::Neg);
+    forEachChild(expr, [&](const Expr& child) {
+        if (arithmetic && child.kind == Expr::Kind::Name) out.insert(static_cast<const NameExpr&>(child).name);
+        collectOperands(child, out);
+    });
+}
+
+// Names assigned in a block, not counting nested function bodies
+void CppEmitter::collectAssigned(const Block& block, std::set<std::string>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Assign:
+                for (auto& names : static_cast<const AssignStmt&>(*stmt).targets) {
+                    for (auto& name : names) {
+                        if (!name.empty()) out.insert(name);
+                    }
+                }
+                break;
+            case Stmt::Kind::AugAssign:
+                for (auto& name : static_cast<const AugAssignStmt&>(*stmt).targets) {
+                    if (!name.empty()) out.insert(name);
+                }
+                break;
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    collectAssigned(branch, out);
+                }
+                collectAssigned(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While:
+                collectAssigned(static_cast<const WhileStmt&>(*stmt).body, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Definitions of all def statements, at any depth
+void CppEmitter::collectDefinitions(const Block& block, std::vector<const FunctionDefStmt*>& out) {
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::FunctionDef: {
+                auto& def = static_cast<const FunctionDefStmt&>(*stmt);
+                out.push_back(&def);
+                collectDefinitions(def.body, out);
+                break;
+            }
+            case Stmt::Kind::If: {
+                auto& ifStmt = static_cast<const IfStmt&>(*stmt);
+                for (auto& branch : ifStmt.branches) {
+                    collectDefinitions(branch, out);
+                }
+                collectDefinitions(ifStmt.orelse, out);
+                break;
+            }
+            case Stmt::Kind::While:
+                collectDefinitions(static_cast<const WhileStmt&>(*stmt).body, out);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// C++ text
+void CppEmitter::line(const std::string& text) {
+    out->append(indent * 4, ' ');
+    *out += text;
+    *out += '\n';
+}
+
+std::string CppEmitter::temp() {
+    return "t" + std::to_string(nextTemp++);
+}
+
+std::string CppEmitter::constant(const Value& value) {
+    std::string init = constantInit(value);
+    auto it = constantIndex.find(init);
+    if (it == constantIndex.end()) {
+        it = constantIndex.emplace(init, constants.size()).first;
+        constants.push_back(init);
+    }
+    return "k" + std::to_string(it->second);
+}
+
+std::string CppEmitter::constantInit(const Value& value) {
+    switch (value.type) {
+        case Value::BOOL:
+            return value.boolVal ? "Value(true)" : "Value(false)";
+        case Value::INT: {
+            long long n;
+            if (value.intVal.toLongLong(n) && n >= -2147483647 && n <= 2147483647) return "Value(" + std::to_string(n) + ")";
+            return "Value(BigInt(" + literal(value.intVal.toString()) + "))";
+        }
+        case Value::FLOAT:
+            if (std::isnan(value.floatVal)) return "Value(std::numeric_limits<double>::quiet_NaN())";
+            if (std::isinf(value.floatVal)) {
+                return value.floatVal > 0 ? "Value(std::numeric_limits<double>::infinity())"
+                                          : "Value(-std::numeric_limits<double>::infinity())";
+            }
+            return "Value(" + unparen(doubleLiteral(value.floatVal)) + ")";
+        case Value::STRING:
+            if (value.strVal.find('\0') != std::string::npos) {
+                return "Value(std::string(" + literal(value.strVal) + ", " + std::to_string(value.strVal.size()) + "))";
+            }
+            return "Value(std::string(" + literal(value.strVal) + "))";
+        case Value::TUPLE: {
+            std::string elements;
+            for (size_t i = 0; i < value.tupleVal.size(); i++) {
+                if (i > 0) elements += ", ";
+                elements += constantInit(value.tupleVal[i]);
+            }
+            return "makeTuple(" + elements + ")";
+        }
+        default:
+            return "Value()";
+    }
+}
+
+// Locals are prefixed l_ and globals g_, which keeps them clear of C++
+// keywords and of each other
+std::string CppEmitter::variable(const std::string& name) {
+    if (locals.count(name)) return "l_" + mangle(name);
+    referencedGlobals.insert(name);
+    return "g_" + mangle(name);
+}
+
+std::string CppEmitter::signature(int number, bool variant) const {
+    auto& def = *definitions[number - 1];
+    std::string params;
+    for (size_t p = 0; p < def.params.size(); p++) {
+        if (p > 0) params += ", ";
+        params += variant && intParams.at(number)[p] ? "Int l_" : "Value l_";
+        params += mangle(def.params[p]);
+    }
+    return "Value " + functionName(number, variant) + "(" + params + ")";
+}
+
+std::string CppEmitter::functionName(int number, bool variant) const {
+    return "f" + std::to_string(number) + "_" + mangle(definitions[number - 1]->name) + (variant ? "_int" : "");
+}
+
+std::string CppEmitter::boxed(const Code& code) {
+    if (code.constant) return constant(*code.constant);
+    if (code.type == Type::Boxed) return code.text;
+    if (code.type == Type::Int) return "box(" + unparen(code.text) + ")";
+    return "Value(" + unparen(code.text) + ")";
+}
+
+std::string CppEmitter::truth(const Code& code) {
+    switch (code.type) {
+        case Type::Double: return "(" + code.text + " != 0.0)";
+        case Type::Bool: return code.text;
+        default: return code.text + ".toBool()";
+    }
+}
+
+std::string CppEmitter::asDouble(const Code& code, const Expr& expr) {
+    if (isIntConstant(expr)) {
+        return doubleLiteral(static_cast<const ConstantExpr&>(expr).value.intVal.toDouble());
+    }
+    switch (code.type) {
+        case Type::Int: return code.text + ".toDouble()";
+        case Type::Double: return code.text;
+        case Type::Bool:
+            if (code.stable && (code.text == "true" || code.text == "false")) return doubleLiteral(code.text == "true");
+            return "(" + code.text + " ? 1.0 : 0.0)";
+        default: return code.text + ".toFloat()";
+    }
+}
+
+// Inference guarantees a typed destination only gets values of its type
+std::string CppEmitter::convert(const Code& code, Type type) {
+    return type == Type::Boxed ? boxed(code) : code.text;
+}
+
+// A boxed temporary is used once, so it is moved from
+std::string CppEmitter::argument(const Code& code) {
+    if (code.type == Type::Boxed && code.temporary) return "std::move(" + code.text + ")";
+    return boxed(code);
+}
+
+std::string CppEmitter::typeName(Type type) {
+    switch (type) {
+        case Type::Int: return "Int";
+        case Type::Double: return "double";
+        case Type::Bool: return "bool";
+        default: return "Value";
+    }
+}
+
+// Characters outside [A-Za-z0-9_] are spelled _xHH
+std::string CppEmitter::mangle(const std::string& name) {
+    std::string result;
+    for (unsigned char c : name) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+            result += c;
+        } else {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "_x%02X", c);
+            result += buf;
+        }
+    }
+    return result;
+}
+
+std::string CppEmitter::literal(const std::string& s) {
+    std::string result = "\"";
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\%03o", c);
+                    result += buf;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+
+// Hexadecimal floating literals are exact; negative ones are parenthesized
+// so that they can follow a unary minus
+std::string CppEmitter::doubleLiteral(double d) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%a", d);
+    return std::signbit(d) ? "(" + std::string(buf) + ")" : std::string(buf);
+}
+
+// Strips parentheses around the whole expression
+std::string CppEmitter::unparen(const std::string& text) {
+    if (text.size() < 2 || text.front() != '(' || text.back() != ')') return text;
+    int depth = 0;
+    for (size_t i = 0; i + 1 < text.size(); i++) {
+        if (text[i] == '(') depth++;
+        else if (text[i] == ')') depth--;
+        if (depth == 0) return text;
+    }
+    return text.substr(1, text.size() - 2);
+}
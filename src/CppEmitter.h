@@ -0,0 +1,136 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_CPP_EMITTER_H
+#define PYTHON_INTERPRETER_CPP_EMITTER_H
+
+#include "Ast.h"
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Translates an ast::Program into a standalone C++ translation unit, written
+// by --emit-cpp. The generated code includes Ast.h and links against
+// Value.cpp; names are resolved the same way Compiler resolves them, so it
+// prints what the VM prints.
+//
+// Globals become Values at namespace scope and every def statement becomes a
+// C++ function. A name may be bound to several defs over a run, so each
+// function slot records the def it is bound to and call sites bind their
+// arguments against every def of the name ahead of time. A local whose first
+// use is an unconditional assignment and whose every assignment is an int, a
+// float or a bool is an Int, a double or a bool variable; an Int is a machine
+// word that widens to a BigInt on overflow. All other values stay Values.
+// A def whose parameters are used in arithmetic also gets a variant taking
+// them as Ints, which calls with Int arguments go to directly.
+//
+// Calls are limited to VM::kDefaultMaxDepth frames; a function calling
+// itself from its tail jumps back to its top, and other tail calls leave
+// the depth alone, as they do in the VM.
+class CppEmitter {
+public:
+    static constexpr long kMaxChunkLines = 200;     // of top-level code per generated function
+    
+    void emit(const ast::Program& program, std::ostream& os);
+
+private:
+    // C++ type of an expression; Unknown only while locals are inferred
+    enum class Type { Unknown, Int, Double, Bool, Boxed };
+    
+    // A C++ expression; stable ones (constants, temporaries, locals) cannot
+    // change while later operands are evaluated
+    struct Code {
+        std::string text;
+        Type type = Type::Boxed;
+        bool stable = false;
+        bool temporary = false;
+        const Value* constant = nullptr;    // the literal it spells, boxed as a constant
+    };
+    
+    std::set<std::string> globalNames;
+    std::set<std::string> functionNames;
+    std::set<std::string> referencedGlobals;
+    std::vector<const ast::FunctionDefStmt*> definitions;  // numbered from 1
+    std::map<int, std::vector<int>> definitionsOf;          // by function slot
+    const std::vector<std::string>* slotNames = nullptr;
+    std::vector<std::string> constants;                     // initializers
+    std::map<std::string, int> constantIndex;
+    std::map<int, std::vector<bool>> intParams;             // by def number, for its Int variant
+    
+    std::map<std::string, Type> locals;     // of the function being emitted
+    bool inFunction = false;
+    int function = 0;                       // def number of the function being emitted
+    bool inVariant = false;
+    bool tailCalled = false;
+    std::string* out = nullptr;
+    int indent = 0;
+    int loopDepth = 0;
+    int nextTemp = 0;
+    
+    void emitFunction(int number, std::string& text);
+    void emitBody(int number, bool variant, std::string& text);
+    void emitBlock(const ast::Block& block);
+    void emitStmt(const ast::Stmt& stmt);
+    void emitAssign(const ast::AssignStmt& stmt);
+    void emitAugAssign(const ast::AugAssignStmt& stmt);
+    void emitIf(const ast::IfStmt& stmt);
+    void emitWhile(const ast::WhileStmt& stmt);
+    void emitFunctionDef(const ast::FunctionDefStmt& stmt);
+    void store(const std::string& name, const Code& value, bool keep);
+    
+    Code emitExpr(const ast::Expr& expr);
+    Code emitCompare(const ast::CompareExpr& expr);
+    Code emitLogical(const ast::LogicalExpr& expr);
+    Code emitCall(const ast::CallExpr& expr, bool tail);
+    std::vector<int> bindArguments(const ast::FunctionDefStmt& def, const ast::CallExpr& expr);
+    bool takesInts(int number, const std::vector<int>& bound, const std::vector<Code>& values) const;
+    std::string callText(int number, const std::vector<int>& bound, const std::vector<Code>& values);
+    void emitSelfTailCall(const ast::CallExpr& expr, const std::vector<int>& bound, const std::vector<Code>& values);
+    std::vector<Code> emitOperands(const std::vector<const ast::Expr*>& operands);
+    Code capture(const ast::Expr& expr, std::string& prelude);
+    Code materialize(const Code& code);
+    Code binary(ast::BinaryOp op, const Code& left, const ast::Expr& leftExpr,
+                const Code& right, const ast::Expr& rightExpr, bool reuseLeft);
+    std::string compare(ast::CompareOp op, const Code& left, const ast::Expr& leftExpr,
+                        const Code& right, const ast::Expr& rightExpr);
+    
+    // Typing shared by inference and emission
+    void inferLocals(const ast::FunctionDefStmt& def, const std::vector<bool>& ints);
+    void inferBlock(const ast::Block& block, bool& changed);
+    void refine(const std::string& name, Type type, bool& changed);
+    Type typeOf(const ast::Expr& expr) const;
+    static Type binaryType(ast::BinaryOp op, Type left, const ast::Expr& leftExpr, Type right, const ast::Expr& rightExpr);
+    static bool numeric(Type type, const ast::Expr& expr);
+    static bool compareNumerically(Type left, const ast::Expr& leftExpr, Type right, const ast::Expr& rightExpr);
+    static Type join(Type left, Type right);
+    static void firstUses(const ast::Block& block, bool topLevel, std::set<std::string>& seen, std::set<std::string>& clean);
+    static void markNames(const ast::Stmt& stmt, std::set<std::string>& seen);
+    static void markNames(const ast::Expr& expr, std::set<std::string>& seen);
+    static bool hasEffects(const ast::Expr& expr);
+    static bool reads(const ast::Expr& expr, const std::string& name);
+    static void collectOperands(const ast::Block& block, std::set<std::string>& out);
+    static void collectOperands(const ast::Expr& expr, std::set<std::string>& out);
+    static void collectAssigned(const ast::Block& block, std::set<std::string>& out);
+    static void collectDefinitions(const ast::Block& block, std::vector<const ast::FunctionDefStmt*>& out);
+    
+    // C++ text
+    void line(const std::string& text);
+    std::string temp();
+    std::string constant(const Value& value);
+    std::string constantInit(const Value& value);
+    std::string variable(const std::string& name);
+    std::string signature(int number, bool variant) const;
+    std::string functionName(int number, bool variant) const;
+    std::string boxed(const Code& code);
+    static std::string truth(const Code& code);
+    static std::string asDouble(const Code& code, const ast::Expr& expr);
+    std::string convert(const Code& code, Type type);
+    std::string argument(const Code& code);
+    static std::string typeName(Type type);
+    static std::string mangle(const std::string& name);
+    static std::string literal(const std::string& s);
+    static std::string doubleLiteral(double d);
+    static std::string unparen(const std::string& text);
+};
+
+#endif//PYTHON_INTERPRETER_CPP_EMITTER_H
@@ -0,0 +1,66 @@
+#include "Environment.h"
+
+// Frame Implementation
+Frame::Frame()
+    : arena(initialBuffer, sizeof(initialBuffer)), locals(&arena), staging(&arena), staged(&arena) {}
+
+void Frame::reset() {
+    locals.clear();
+    // Drop the containers' buffers before the arena memory goes away
+    std::pmr::vector<Value>(&arena).swap(staging);
+    std::pmr::vector<char>(&arena).swap(staged);
+    arena.release();
+    returnValue = Value();
+}
+
+// Environment Implementation
+Value Environment::get(const std::string& name) const {
+    // Check local scopes first (from innermost to outermost)
+    for (size_t d = frameDepth; d-- > 0;) {
+        auto& locals = framePool[d]->locals;
+        auto it = locals.find(std::string_view(name));
+        if (it != locals.end()) return it->second;
+    }
+    // Check global scope
+    auto it = globalScope.find(name);
+    if (it != globalScope.end()) return it->second;
+    return Value(); // None
+}
+
+void Environment::set(const std::string& name, Value val) {
+    if (frameDepth > 0) {
+        // Check if variable exists in local scopes first
+        for (size_t d = frameDepth; d-- > 0;) {
+            auto& locals = framePool[d]->locals;
+            auto it = locals.find(std::string_view(name));
+            if (it != locals.end()) {
+                it->second = std::move(val);
+                return;
+            }
+        }
+        // Check if it exists in global scope
+        auto it = globalScope.find(name);
+        if (it != globalScope.end()) {
+            it->second = std::move(val);
+            return;
+        }
+        // Not found anywhere, set in current scope
+        Frame& frame = *framePool[frameDepth - 1];
+        frame.locals.emplace(std::pmr::string(name.data(), name.size(), &frame.arena), std::move(val));
+    } else {
+        globalScope[name] = std::move(val);
+    }
+}
+
+Frame& Environment::enterScope() {
+    if (frameDepth == framePool.size()) {
+        framePool.push_back(std::make_unique<Frame>());
+    }
+    return *framePool[frameDepth++];
+}
+
+void Environment::exitScope() {
+    if (frameDepth > 0) {
+        framePool[--frameDepth]->reset();
+    }
+}
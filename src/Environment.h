@@ -0,0 +1,48 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_ENVIRONMENT_H
+#define PYTHON_INTERPRETER_ENVIRONMENT_H
+
+#include "Value.h"
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+
+// Activation record of a user function call. The locals map, its keys and the
+// argument staging area are carved out of a per-frame bump arena that is
+// released in one step when the call returns; frames are pooled for reuse.
+struct Frame {
+    static constexpr size_t kInitialArenaSize = 1024;
+    
+    alignas(std::max_align_t) unsigned char initialBuffer[kInitialArenaSize];
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::map<std::pmr::string, Value, std::less<>> locals;
+    std::pmr::vector<Value> staging;
+    std::pmr::vector<char> staged;
+    Value returnValue;
+    
+    Frame();
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+    
+    void reset();
+};
+
+// Name-based variable storage: the global scope plus a stack of pooled frames
+class Environment {
+private:
+    std::map<std::string, Value> globalScope;
+    std::vector<std::unique_ptr<Frame>> framePool;
+    size_t frameDepth = 0;
+
+public:
+    Value get(const std::string& name) const;
+    void set(const std::string& name, Value val);
+    Frame& enterScope();
+    void exitScope();
+    Frame* currentFrame() { return frameDepth > 0 ? framePool[frameDepth - 1].get() : nullptr; }
+};
+
+#endif//PYTHON_INTERPRETER_ENVIRONMENT_H
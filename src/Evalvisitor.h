@@ -3,128 +3,117 @@
 #define PYTHON_INTERPRETER_EVALVISITOR_H
 
 #include "Python3ParserBaseVisitor.h"
+#include "Python3Lexer.h"
+#include "Ast.h"
+#include "Value.h"
+#include "ControlFlow.h"
+#include "Environment.h"
 #include <string>
 #include <map>
-#include <vector>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <cmath>
-#include <algorithm>
-
-// BigInteger class for arbitrary precision arithmetic
-class BigInt {
-private:
-    std::string value;
-    bool negative;
-    
-    void normalize();
-    static std::string addStrings(const std::string& a, const std::string& b);
-    static std::string subtractStrings(const std::string& a, const std::string& b);
-    static std::string multiplyStrings(const std::string& a, const std::string& b);
-    static std::pair<std::string, std::string> divideStrings(const std::string& a, const std::string& b);
-    static int compareStrings(const std::string& a, const std::string& b);
-    
-public:
-    BigInt();
-    BigInt(const std::string& s);
-    BigInt(long long n);
-    BigInt(int n);
-    BigInt(const BigInt& other);
-    
-    BigInt operator+(const BigInt& other) const;
-    BigInt operator-(const BigInt& other) const;
-    BigInt operator*(const BigInt& other) const;
-    BigInt operator/(const BigInt& other) const; // floor division
-    BigInt operator%(const BigInt& other) const;
-    BigInt operator-() const;
-    
-    bool operator<(const BigInt& other) const;
-    bool operator>(const BigInt& other) const;
-    bool operator<=(const BigInt& other) const;
-    bool operator>=(const BigInt& other) const;
-    bool operator==(const BigInt& other) const;
-    bool operator!=(const BigInt& other) const;
-    
-    std::string toString() const;
-    double toDouble() const;
-    bool isZero() const;
-    bool isNegative() const { return negative; }
-};
-
-// Value class to hold different Python types
-class Value {
-public:
-    enum Type { NONE, BOOL, INT, FLOAT, STRING, TUPLE, FUNCTION };
-    
-    Type type;
-    bool boolVal;
-    BigInt intVal;
-    double floatVal;
-    std::string strVal;
-    std::vector<Value> tupleVal;
-    
-    Value() : type(NONE) {}
-    Value(bool b) : type(BOOL), boolVal(b) {}
-    Value(const BigInt& i) : type(INT), intVal(i) {}
-    Value(int i) : type(INT), intVal(i) {}
-    Value(double f) : type(FLOAT), floatVal(f) {}
-    Value(const std::string& s) : type(STRING), strVal(s) {}
-    Value(const std::vector<Value>& t) : type(TUPLE), tupleVal(t) {}
-    
-    std::string toString() const;
-    bool toBool() const;
-    double toFloat() const;
-    BigInt toInt() const;
-    
-    Value operator+(const Value& other) const;
-    Value operator-(const Value& other) const;
-    Value operator*(const Value& other) const;
-    Value operator/(const Value& other) const;
-    Value operator%(const Value& other) const;
-    Value floordiv(const Value& other) const;
-    Value operator-() const;
-    
-    bool operator<(const Value& other) const;
-    bool operator>(const Value& other) const;
-    bool operator<=(const Value& other) const;
-    bool operator>=(const Value& other) const;
-    bool operator==(const Value& other) const;
-    bool operator!=(const Value& other) const;
-};
-
-// Exception classes for control flow
-class ReturnException {
-public:
-    Value value;
-    ReturnException(const Value& v) : value(v) {}
-};
-
-class BreakException {};
-class ContinueException {};
 
 // Function definition
 struct FunctionDef {
     std::vector<std::string> params;
     std::vector<Value> defaults;
     Python3Parser::SuiteContext* body;
-    std::map<std::string, Value>* globalScope;
 };
 
 class EvalVisitor : public Python3ParserBaseVisitor {
 private:
-    std::map<std::string, Value> globalScope;
-    std::vector<std::map<std::string, Value>> scopeStack;
+    // An expr_stmt with its targets resolved, built the first time it runs.
+    // targets holds the names of each target testlist, "" where a target is
+    // not a bare name; an expression statement has none
+    struct Assignment {
+        std::vector<std::vector<std::string>> targets;
+        Python3Parser::TestlistContext* value = nullptr;
+        std::vector<Python3Parser::TestContext*> elements;  // of a parallel assignment's value
+        bool augmented = false;
+        ast::BinaryOp op = ast::BinaryOp::Add;
+    };
+    
+    // Parses one expression of an f-string STRING token; the tree lives as
+    // long as the parser
+    struct ExpressionParser {
+        antlr4::ANTLRInputStream input;
+        Python3Lexer lexer;
+        antlr4::CommonTokenStream tokens;
+        Python3Parser parser;
+        
+        explicit ExpressionParser(const std::string& text) : input(text), lexer(&input), tokens(&lexer), parser(&tokens) {}
+    };
+    
+    // A string atom or format_string split into literal text and the
+    // expressions between, built the first time it is evaluated
+    struct FString {
+        struct Part {
+            std::string literal;
+            Python3Parser::TestContext* test = nullptr;
+            Python3Parser::TestlistContext* testlist = nullptr;
+        };
+        
+        std::vector<Part> parts;
+        size_t literalSize = 0;
+        std::vector<std::unique_ptr<ExpressionParser>> parsers;
+        
+        void addLiteral(const std::string& text);
+    };
+    
+    // Where evaluating a test really starts: the first rule below it that
+    // does more than pass on its only child, or the value of a constant atom
+    struct Shortcut {
+        enum class Rule : uint8_t { Constant, OrTest, AndTest, NotTest, Comparison, ArithExpr, Term, Factor, AtomExpr, Atom };
+        
+        Rule rule;
+        antlr4::ParserRuleContext* node;
+        Value constant;
+    };
+    
+    Environment env;
     std::map<std::string, FunctionDef> functions;
+    std::unordered_map<Python3Parser::TestContext*, Shortcut> shortcuts;
+    std::unordered_map<Python3Parser::Expr_stmtContext*, Assignment> assignments;
+    std::unordered_map<antlr4::ParserRuleContext*, FString> fstrings;
+    std::string printBuffer;
     
-    Value getValue(const std::string& name);
-    void setValue(const std::string& name, const Value& val);
-    void enterScope();
-    void exitScope();
+    void collapseChains(antlr4::tree::ParseTree* tree);
+    Shortcut collapse(Python3Parser::TestContext* test);
+    void splitFString(const std::string& fstr, FString& fstring);
+    Value format(const FString& fstring);
+    const Assignment& assignmentOf(Python3Parser::Expr_stmtContext* ctx);
+    static std::string targetName(Python3Parser::TestContext* test);
+    static ast::CompareOp compareOp(Python3Parser::Comp_opContext* op);
     
-    std::string evaluateFString(const std::string& fstr);
+    // Typed evaluation: statements return nothing and expressions return a
+    // Value directly, so std::any only appears at the visit* entry points
+    void execFuncdef(Python3Parser::FuncdefContext *ctx);
+    Completion execStmt(Python3Parser::StmtContext *ctx);
+    Completion execSimpleStmt(Python3Parser::Simple_stmtContext *ctx);
+    void execExprStmt(Python3Parser::Expr_stmtContext *ctx);
+    Completion execFlowStmt(Python3Parser::Flow_stmtContext *ctx);
+    Completion execReturn(Python3Parser::Return_stmtContext *ctx);
+    Completion execCompoundStmt(Python3Parser::Compound_stmtContext *ctx);
+    Completion execIfStmt(Python3Parser::If_stmtContext *ctx);
+    Completion execWhileStmt(Python3Parser::While_stmtContext *ctx);
+    Completion execSuite(Python3Parser::SuiteContext *ctx);
     
+    Value evalTest(Python3Parser::TestContext *ctx);
+    Value evalOrTest(Python3Parser::Or_testContext *ctx);
+    Value evalAndTest(Python3Parser::And_testContext *ctx);
+    Value evalNotTest(Python3Parser::Not_testContext *ctx);
+    Value evalComparison(Python3Parser::ComparisonContext *ctx);
+    Value evalArithExpr(Python3Parser::Arith_exprContext *ctx);
+    Value evalTerm(Python3Parser::TermContext *ctx);
+    Value evalFactor(Python3Parser::FactorContext *ctx);
+    Value evalAtomExpr(Python3Parser::Atom_exprContext *ctx);
+    Value evalAtom(Python3Parser::AtomContext *ctx);
+    Value evalFormatString(Python3Parser::Format_stringContext *ctx);
+    Value evalTestlist(Python3Parser::TestlistContext *ctx);
+    Value evalArgument(Python3Parser::ArgumentContext *ctx);
+
 public:
     EvalVisitor();
     
@@ -0,0 +1,296 @@
+#include "Interpreter.h"
+#include <iostream>
+#include <algorithm>
+
+using namespace ast;
+
+void Interpreter::run(const Program& program) {
+    functions.resize(program.functionNames.size());
+    for (size_t i = 0; i < program.functionNames.size(); i++) {
+        functionSlots.emplace(program.functionNames[i], i);
+    }
+    execBlock(program.body);
+}
+
+// Statements
+Completion Interpreter::execBlock(const Block& block) {
+    for (auto& stmt : block) {
+        Completion completion = exec(*stmt);
+        if (completion != Completion::Normal) return completion;
+    }
+    return Completion::Normal;
+}
+
+Completion Interpreter::exec(const Stmt& stmt) {
+    switch (stmt.kind) {
+        case Stmt::Kind::Expr:
+            eval(*static_cast<const ExprStmt&>(stmt).expr);
+            break;
+        case Stmt::Kind::Assign:
+            execAssign(static_cast<const AssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::AugAssign:
+            execAugAssign(static_cast<const AugAssignStmt&>(stmt));
+            break;
+        case Stmt::Kind::If:
+            return execIf(static_cast<const IfStmt&>(stmt));
+        case Stmt::Kind::While:
+            return execWhile(static_cast<const WhileStmt&>(stmt));
+        case Stmt::Kind::Break:
+            return Completion::Break;
+        case Stmt::Kind::Continue:
+            return Completion::Continue;
+        case Stmt::Kind::Return: {
+            auto& ret = static_cast<const ReturnStmt&>(stmt);
+            Value value = ret.value ? eval(*ret.value) : Value();
+            if (Frame* frame = env.currentFrame()) frame->returnValue = std::move(value);
+            return Completion::Return;
+        }
+        case Stmt::Kind::FunctionDef:
+            execFunctionDef(static_cast<const FunctionDefStmt&>(stmt));
+            break;
+    }
+    return Completion::Normal;
+}
+
+void Interpreter::execAssign(const AssignStmt& stmt) {
+    // Parallel assignment a, b = x, y: stage the right-hand values and
+    // store them directly without building an intermediate tuple
+    if (stmt.targets.size() == 1 && stmt.value->kind == Expr::Kind::Tuple) {
+        auto& names = stmt.targets[0];
+        auto& elements = static_cast<const TupleExpr&>(*stmt.value).elements;
+        if (names.size() == elements.size()) {
+            size_t n = elements.size();
+            Value inlineStage[Tuple::kInlineCapacity];
+            std::vector<Value> heapStage;
+            Value* stage = inlineStage;
+            if (n > Tuple::kInlineCapacity) {
+                heapStage.resize(n);
+                stage = heapStage.data();
+            }
+            for (size_t j = 0; j < n; j++) {
+                stage[j] = eval(*elements[j]);
+            }
+            for (size_t j = 0; j < n; j++) {
+                if (!names[j].empty()) env.set(names[j], std::move(stage[j]));
+            }
+            return;
+        }
+    }
+    
+    Value value = eval(*stmt.value);
+    
+    for (size_t i = 0; i < stmt.targets.size(); i++) {
+        auto& names = stmt.targets[i];
+        
+        if (names.size() == 1) {
+            if (!names[0].empty()) env.set(names[0], value);
+        } else if (value.type == Value::TUPLE) {
+            // Multiple assignment from a tuple value: a, b = f()
+            // A tuple nobody else references can give up its elements
+            Tuple& tuple = *value.tupleVal.get();
+            bool steal = value.tupleVal.unique() && i == stmt.targets.size() - 1;
+            for (size_t j = 0; j < names.size() && j < tuple.size(); j++) {
+                if (names[j].empty()) continue;
+                if (steal) env.set(names[j], std::move(tuple[j]));
+                else env.set(names[j], tuple[j]);
+            }
+        }
+    }
+}
+
+void Interpreter::execAugAssign(const AugAssignStmt& stmt) {
+    Value rightVal = eval(*stmt.value);
+    for (auto& name : stmt.targets) {
+        if (name.empty()) continue;
+        env.set(name, applyBinary(stmt.op, env.get(name), rightVal));
+    }
+}
+
+Completion Interpreter::execIf(const IfStmt& stmt) {
+    for (size_t i = 0; i < stmt.conditions.size(); i++) {
+        if (eval(*stmt.conditions[i]).toBool()) {
+            return execBlock(stmt.branches[i]);
+        }
+    }
+    return execBlock(stmt.orelse);
+}
+
+Completion Interpreter::execWhile(const WhileStmt& stmt) {
+    while (eval(*stmt.condition).toBool()) {
+        Completion completion = execBlock(stmt.body);
+        if (completion == Completion::Break) break;
+        if (completion == Completion::Return) return completion;
+    }
+    return Completion::Normal;
+}
+
+void Interpreter::execFunctionDef(const FunctionDefStmt& stmt) {
+    Function func;
+    func.def = &stmt;
+    for (auto& def : stmt.defaults) {
+        func.defaults.push_back(eval(*def));
+    }
+    functions[stmt.function] = std::move(func);
+}
+
+// Expressions
+Value Interpreter::eval(const Expr& expr) {
+    switch (expr.kind) {
+        case Expr::Kind::Constant:
+            return static_cast<const ConstantExpr&>(expr).value;
+        case Expr::Kind::Name:
+            return evalName(static_cast<const NameExpr&>(expr));
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<const UnaryExpr&>(expr);
+            Value operand = eval(*unary.operand);
+            if (unary.op == UnaryOp::Not) return Value(!operand.toBool());
+            return -std::move(operand);
+        }
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<const BinaryExpr&>(expr);
+            Value left = eval(*binary.left);
+            Value right = eval(*binary.right);
+            return applyBinary(binary.op, std::move(left), right);
+        }
+        case Expr::Kind::Compare:
+            return evalCompare(static_cast<const CompareExpr&>(expr));
+        case Expr::Kind::Logical:
+            return evalLogical(static_cast<const LogicalExpr&>(expr));
+        case Expr::Kind::Call:
+            return evalCall(static_cast<const CallExpr&>(expr));
+        case Expr::Kind::Tuple:
+            return evalTuple(static_cast<const TupleExpr&>(expr));
+        case Expr::Kind::FString:
+            return evalFString(static_cast<const FStringExpr&>(expr));
+    }
+    return Value();
+}
+
+Value Interpreter::evalName(const NameExpr& expr) {
+    // A function name evaluates to its name as a string
+    auto slot = functionSlots.find(expr.name);
+    if (slot != functionSlots.end() && functions[slot->second].def) {
+        return Value(expr.name);
+    }
+    return env.get(expr.name);
+}
+
+Value Interpreter::evalCompare(const CompareExpr& expr) {
+    // Operands are evaluated as the links need them, each at most once
+    Value left = eval(*expr.operands[0]);
+    for (size_t i = 0; i < expr.ops.size(); i++) {
+        Value right = eval(*expr.operands[i + 1]);
+        if (!applyCompare(expr.ops[i], left, right)) return Value(false);
+        left = std::move(right);
+    }
+    return Value(true);
+}
+
+Value Interpreter::evalLogical(const LogicalExpr& expr) {
+    Value result = eval(*expr.operands[0]);
+    
+    for (size_t i = 1; i < expr.operands.size(); i++) {
+        // Short-circuit
+        if (result.toBool() == (expr.op == LogicalOp::Or)) return result;
+        result = eval(*expr.operands[i]);
+    }
+    return result;
+}
+
+Value Interpreter::evalCall(const CallExpr& expr) {
+    // Built-in functions
+    if (expr.builtin == Builtin::Print) {
+        print(expr);
+        return Value();
+    }
+    if (expr.builtin != Builtin::None) {
+        Value arg = expr.args.empty() ? Value() : eval(*expr.args[0].value);
+        return applyConversion(expr.builtin, arg);
+    }
+    
+    const Function& func = functions[expr.function];
+    if (!func.def) return eval(*expr.atom);
+    return callFunction(func, expr);
+}
+
+Value Interpreter::callFunction(const Function& func, const CallExpr& call) {
+    auto& params = func.def->params;
+    
+    // Stage arguments in the new frame's arena; the frame's locals stay
+    // empty until binding, so argument evaluation still sees the caller's scope
+    Frame& frame = env.enterScope();
+    frame.staging.resize(params.size());
+    frame.staged.assign(params.size(), 0);
+    
+    if (!call.args.empty()) {
+        size_t posArgCount = 0;
+        
+        for (auto& arg : call.args) {
+            if (!arg.keyword.empty()) {
+                auto param = std::find(params.begin(), params.end(), arg.keyword);
+                if (param != params.end()) {
+                    size_t idx = param - params.begin();
+                    frame.staging[idx] = eval(*arg.value);
+                    frame.staged[idx] = 1;
+                }
+            } else if (posArgCount < params.size()) {
+                frame.staging[posArgCount] = eval(*arg.value);
+                frame.staged[posArgCount] = 1;
+                posArgCount++;
+            }
+        }
+    }
+    
+    // Fill in default values, also when the call passes no arguments
+    size_t defaultStart = params.size() - func.defaults.size();
+    for (size_t i = defaultStart; i < params.size(); i++) {
+        if (!frame.staged[i]) {
+            frame.staging[i] = func.defaults[i - defaultStart];
+            frame.staged[i] = 1;
+        }
+    }
+    
+    // Bind the arguments and execute the function body
+    for (size_t i = 0; i < params.size(); i++) {
+        if (frame.staged[i]) env.set(params[i], std::move(frame.staging[i]));
+    }
+    
+    execBlock(func.def->body);
+    Value result = std::move(frame.returnValue);
+    env.exitScope();
+    return result;
+}
+
+void Interpreter::print(const CallExpr& call) {
+    std::vector<Value> args;
+    for (auto& arg : call.args) {
+        args.push_back(eval(*arg.value));
+    }
+    
+    // Format the whole line into a reused buffer and write it once
+    printBuffer.clear();
+    for (size_t i = 0; i < args.size(); i++) {
+        if (i > 0) printBuffer += ' ';
+        args[i].appendTo(printBuffer);
+    }
+    printBuffer += '\n';
+    std::cout.write(printBuffer.data(), printBuffer.size());
+}
+
+Value Interpreter::evalTuple(const TupleExpr& expr) {
+    TupleRef tuple = Tuple::make(expr.elements.size());
+    for (size_t i = 0; i < expr.elements.size(); i++) {
+        (*tuple.get())[i] = eval(*expr.elements[i]);
+    }
+    return Value(std::move(tuple));
+}
+
+Value Interpreter::evalFString(const FStringExpr& expr) {
+    std::string result;
+    for (auto& part : expr.parts) {
+        if (part.expr) eval(*part.expr).appendTo(result);
+        else result += part.literal;
+    }
+    return Value(std::move(result));
+}
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_INTERPRETER_H
+#define PYTHON_INTERPRETER_INTERPRETER_H
+
+#include "Ast.h"
+#include "Value.h"
+#include "ControlFlow.h"
+#include "Environment.h"
+#include <string>
+#include <map>
+#include <vector>
+
+// Executes a lowered ast::Program by walking the tree
+class Interpreter {
+public:
+    void run(const ast::Program& program);
+
+private:
+    // Runtime record of a def statement; defaults are evaluated when it runs
+    struct Function {
+        const ast::FunctionDefStmt* def = nullptr;
+        std::vector<Value> defaults;
+    };
+    
+    Environment env;
+    std::vector<Function> functions;    // by function slot; def is null until defined
+    std::map<std::string, int> functionSlots;
+    std::string printBuffer;
+    
+    Completion execBlock(const ast::Block& block);
+    Completion exec(const ast::Stmt& stmt);
+    void execAssign(const ast::AssignStmt& stmt);
+    void execAugAssign(const ast::AugAssignStmt& stmt);
+    Completion execIf(const ast::IfStmt& stmt);
+    Completion execWhile(const ast::WhileStmt& stmt);
+    void execFunctionDef(const ast::FunctionDefStmt& stmt);
+    
+    Value eval(const ast::Expr& expr);
+    Value evalName(const ast::NameExpr& expr);
+    Value evalCompare(const ast::CompareExpr& expr);
+    Value evalLogical(const ast::LogicalExpr& expr);
+    Value evalCall(const ast::CallExpr& expr);
+    Value evalTuple(const ast::TupleExpr& expr);
+    Value evalFString(const ast::FStringExpr& expr);
+    Value callFunction(const Function& func, const ast::CallExpr& call);
+    void print(const ast::CallExpr& call);
+};
+
+#endif//PYTHON_INTERPRETER_INTERPRETER_H
@@ -0,0 +1,443 @@
+#include "Jit.h"
+#include "Unboxed.h"
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using bytecode::Op;
+
+#ifdef JIT_X86_64
+namespace {
+
+// Machine registers by encoding. The unboxed slots are addressed from rbx and
+// the registers from rbp for the whole body; rdi, rsi, rdx and xmm0/xmm1
+// carry helper arguments.
+enum Reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RBP = 5, RSI = 6, RDI = 7 };
+
+// Condition codes; flipping the low bit negates one
+enum Cond : uint8_t { O = 0x0, E = 0x4, NE = 0x5, P = 0xA, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF };
+
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+    
+    size_t here() const { return code.size(); }
+    
+    void emit(std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+    
+    void imm32(int32_t value) {
+        for (int i = 0; i < 4; i++) code.push_back(uint32_t(value) >> (8 * i));
+    }
+    
+    void imm64(uint64_t value) {
+        for (int i = 0; i < 8; i++) code.push_back(value >> (8 * i));
+    }
+    
+    // opcode reg, [base + disp32]
+    void memory(std::initializer_list<uint8_t> opcode, int reg, Reg base, int32_t disp) {
+        emit(opcode);
+        code.push_back(0x80 | reg << 3 | base);
+        imm32(disp);
+    }
+    
+    // Returns the position of the rel32 field to bind later
+    size_t jump() {
+        emit({0xE9});
+        imm32(0);
+        return here() - 4;
+    }
+    
+    size_t jump(Cond cond) {
+        emit({0x0F, uint8_t(0x80 | cond)});
+        imm32(0);
+        return here() - 4;
+    }
+    
+    void bind(size_t field, size_t target) {
+        int32_t rel = int32_t(target) - int32_t(field + 4);
+        std::memcpy(&code[field], &rel, 4);
+    }
+    
+    void call(const void* function) {
+        emit({0x48, 0xB8});
+        imm64(reinterpret_cast<uint64_t>(function));
+        emit({0xFF, 0xD0});
+    }
+};
+
+// Runtime helpers called from native code
+void boxInt(Value* slot, int64_t n) {
+    *slot = boxI64(n);
+}
+
+void boxFloat(Value* slot, double f) {
+    *slot = Value(f);
+}
+
+// Condition temporaries usually hold a bool already
+void storeBool(Value* slot, int b) {
+    if (slot->type == Value::BOOL) slot->boolVal = b != 0;
+    else *slot = Value(b != 0);
+}
+
+int truthy(const Value* v) {
+    return v->toBool();
+}
+
+int floorDiv(int64_t a, int64_t b, int64_t* out) {
+    return floorDivI64(a, b, *out);
+}
+
+int mod(int64_t a, int64_t b, int64_t* out) {
+    return modI64(a, b, *out);
+}
+
+int floorDivBoxed(int64_t a, int64_t b, Value* slot) {
+    int64_t n;
+    if (!floorDivI64(a, b, n)) return 0;
+    *slot = boxI64(n);
+    return 1;
+}
+
+int modBoxed(int64_t a, int64_t b, Value* slot) {
+    int64_t n;
+    if (!modI64(a, b, n)) return 0;
+    *slot = boxI64(n);
+    return 1;
+}
+
+// Float comparisons derived from < and == as Value derives them
+template <ast::CompareOp op>
+int compareF64(double left, double right) {
+    switch (op) {
+        case ast::CompareOp::Lt: return left < right;
+        case ast::CompareOp::Gt: return right < left;
+        case ast::CompareOp::Le: return !(right < left);
+        case ast::CompareOp::Ge: return !(left < right);
+        case ast::CompareOp::Eq: return left == right;
+        case ast::CompareOp::Ne: return !(left == right);
+    }
+    return 0;
+}
+
+const void* const floatCompares[] = {
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Lt>),
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Gt>),
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Le>),
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Ge>),
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Eq>),
+    reinterpret_cast<const void*>(&compareF64<ast::CompareOp::Ne>),
+};
+
+const Cond intCompares[] = {L, G, LE, GE, E, NE};
+
+bool typed(Op op) {
+    return op >= Op::LoadI64;
+}
+
+bool branch(Op op) {
+    return op == Op::JumpIfFalse || op == Op::JumpIfTrue;
+}
+
+int32_t slot(int reg) {
+    return reg * int32_t(sizeof(Unboxed));
+}
+
+int32_t boxed(int reg) {
+    return reg * int32_t(sizeof(Value));
+}
+
+} // namespace
+#endif
+
+Jit::~Jit() {
+#ifdef JIT_X86_64
+    for (auto& region : regions) {
+        munmap(region.first, region.second);
+    }
+#endif
+}
+
+bytecode::Specialization::NativeCode Jit::compile(const bytecode::Module& module, const bytecode::Specialization& spec) {
+#ifdef JIT_X86_64
+    auto& code = spec.body.code;
+    size_t n = code.size();
+    
+    // Loop headers are entry points besides the start; jump targets cannot
+    // be folded into the instruction before them
+    std::vector<char> targeted(n + 1, 0);
+    std::vector<int> entries;
+    for (auto& in : code) {
+        switch (in.op) {
+            case Op::Loop:
+                entries.push_back(in.a);
+                targeted[in.a] = 1;
+                break;
+            case Op::Jump:
+            case Op::JumpIfFalse:
+            case Op::JumpIfTrue:
+            case Op::JumpIfFalseI64:
+            case Op::JumpIfTrueI64:
+            case Op::JumpIfFalseF64:
+            case Op::JumpIfTrueF64:
+                targeted[in.a] = 1;
+                break;
+            case Op::Call:
+                targeted[in.c] = 1;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    std::vector<char> reachable(n + 1, 0);
+    std::vector<size_t> worklist{0}, next;
+    for (int entry : entries) worklist.push_back(entry);
+    while (!worklist.empty()) {
+        size_t at = worklist.back();
+        worklist.pop_back();
+        if (at >= n || reachable[at]) continue;
+        reachable[at] = 1;
+        bytecode::successors(code[at], at, next);
+        worklist.insert(worklist.end(), next.begin(), next.end());
+    }
+    
+    // A typed comparison followed by a branch on its result compiles to one
+    // compare and jump, without storing the bool, when no other reachable
+    // instruction reads that register boxed
+    std::vector<char> folded(n + 1, 0);
+    for (size_t k = 0; k + 1 < n; k++) {
+        bool compare = code[k].op >= Op::LtI64 && code[k].op <= Op::NeF64;
+        if (compare && branch(code[k + 1].op) && code[k + 1].b == code[k].a && !targeted[k + 1]) folded[k + 1] = 1;
+    }
+    std::vector<char> observed(spec.body.numRegs, 0);
+    std::vector<int> reads, writes;
+    for (size_t j = 0; j < n; j++) {
+        if (!reachable[j] || typed(code[j].op) || folded[j]) continue;
+        bytecode::operands(module, code[j], reads, writes);
+        for (int reg : reads) observed[reg] = 1;
+    }
+    for (size_t j = 0; j < n; j++) {
+        if (folded[j] && observed[code[j].b]) folded[j] = 0;
+    }
+    
+    Assembler as;
+    std::vector<size_t> labels(n + 1);
+    std::vector<std::pair<size_t, size_t>> jumps;   // rel32 field, instruction
+    std::vector<std::pair<size_t, int>> exits;      // rel32 field, instruction to resume at
+    std::vector<size_t> leaves;                     // rel32 fields to the epilogue
+    
+    auto exitAt = [&](int k) {
+        as.emit({0xB8});
+        as.imm32(k);
+        leaves.push_back(as.jump());
+    };
+    auto jumpTo = [&](size_t field, int k) { jumps.push_back({field, size_t(k)}); };
+    
+    // push rbx; push rbp; sub rsp, 8; mov rbx, rdi; mov rbp, rsi
+    as.emit({0x53, 0x55, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x48, 0x89, 0xF5});
+    for (int entry : entries) {
+        as.emit({0x81, 0xFA});      // cmp edx, entry
+        as.imm32(entry);
+        jumpTo(as.jump(E), entry);
+    }
+    
+    for (size_t k = 0; k < n; k++) {
+        labels[k] = as.here();
+        auto& in = code[k];
+        if (folded[k]) continue;
+        switch (in.op) {
+            case Op::LoadI64:
+            case Op::LoadF64: {
+                uint64_t bits;
+                if (in.op == Op::LoadI64) bits = module.intConstants[in.b];
+                else std::memcpy(&bits, &module.floatConstants[in.b], 8);
+                as.emit({0x48, 0xB8});
+                as.imm64(bits);
+                as.memory({0x48, 0x89}, RAX, RBX, slot(in.a));
+                break;
+            }
+            case Op::CopyRaw:
+                as.memory({0x48, 0x8B}, RAX, RBX, slot(in.b));
+                as.memory({0x48, 0x89}, RAX, RBX, slot(in.a));
+                break;
+            case Op::BoxI64:
+                as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                as.memory({0x48, 0x8B}, RSI, RBX, slot(in.b));
+                as.call(reinterpret_cast<const void*>(&boxInt));
+                break;
+            case Op::BoxF64:
+                as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                as.memory({0xF2, 0x0F, 0x10}, 0, RBX, slot(in.b));
+                as.call(reinterpret_cast<const void*>(&boxFloat));
+                break;
+            case Op::AddI64:
+            case Op::SubI64:
+            case Op::MulI64:
+            case Op::AddI64Boxed:
+            case Op::SubI64Boxed:
+            case Op::MulI64Boxed: {
+                as.memory({0x48, 0x8B}, RAX, RBX, slot(in.b));
+                if (in.op == Op::AddI64 || in.op == Op::AddI64Boxed) as.memory({0x48, 0x03}, RAX, RBX, slot(in.c));
+                else if (in.op == Op::SubI64 || in.op == Op::SubI64Boxed) as.memory({0x48, 0x2B}, RAX, RBX, slot(in.c));
+                else as.memory({0x48, 0x0F, 0xAF}, RAX, RBX, slot(in.c));
+                exits.push_back({as.jump(O), k});
+                if (in.op == Op::AddI64 || in.op == Op::SubI64 || in.op == Op::MulI64) {
+                    as.memory({0x48, 0x89}, RAX, RBX, slot(in.a));
+                } else {
+                    as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                    as.emit({0x48, 0x89, 0xC6});    // mov rsi, rax
+                    as.call(reinterpret_cast<const void*>(&boxInt));
+                }
+                break;
+            }
+            case Op::FloorDivI64:
+            case Op::ModI64:
+            case Op::FloorDivI64Boxed:
+            case Op::ModI64Boxed: {
+                bool toBoxed = in.op == Op::FloorDivI64Boxed || in.op == Op::ModI64Boxed;
+                bool isMod = in.op == Op::ModI64 || in.op == Op::ModI64Boxed;
+                as.memory({0x48, 0x8B}, RDI, RBX, slot(in.b));
+                as.memory({0x48, 0x8B}, RSI, RBX, slot(in.c));
+                if (toBoxed) as.memory({0x48, 0x8D}, RDX, RBP, boxed(in.a));
+                else as.memory({0x48, 0x8D}, RDX, RBX, slot(in.a));
+                if (toBoxed) as.call(isMod ? reinterpret_cast<const void*>(&modBoxed) : reinterpret_cast<const void*>(&floorDivBoxed));
+                else as.call(isMod ? reinterpret_cast<const void*>(&mod) : reinterpret_cast<const void*>(&floorDiv));
+                as.emit({0x85, 0xC0});      // test eax, eax
+                exits.push_back({as.jump(E), k});
+                break;
+            }
+            case Op::AddF64:
+            case Op::SubF64:
+            case Op::MulF64:
+            case Op::DivF64:
+            case Op::AddF64Boxed:
+            case Op::SubF64Boxed:
+            case Op::MulF64Boxed:
+            case Op::DivF64Boxed: {
+                static const uint8_t opcodes[] = {0x58, 0x5C, 0x59, 0x5E};
+                bool toBoxed = in.op >= Op::AddF64Boxed;
+                int index = int(in.op) - int(toBoxed ? Op::AddF64Boxed : Op::AddF64);
+                as.memory({0xF2, 0x0F, 0x10}, 0, RBX, slot(in.b));
+                as.memory({0xF2, 0x0F, opcodes[index]}, 0, RBX, slot(in.c));
+                if (!toBoxed) {
+                    as.memory({0xF2, 0x0F, 0x11}, 0, RBX, slot(in.a));
+                } else {
+                    as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                    as.call(reinterpret_cast<const void*>(&boxFloat));
+                }
+                break;
+            }
+            case Op::LtI64:
+            case Op::GtI64:
+            case Op::LeI64:
+            case Op::GeI64:
+            case Op::EqI64:
+            case Op::NeI64: {
+                Cond cond = intCompares[int(in.op) - int(Op::LtI64)];
+                as.memory({0x48, 0x8B}, RAX, RBX, slot(in.b));
+                as.memory({0x48, 0x3B}, RAX, RBX, slot(in.c));
+                if (folded[k + 1]) {
+                    auto& next = code[k + 1];
+                    if (next.op == Op::JumpIfFalse) cond = Cond(cond ^ 1);
+                    jumpTo(as.jump(cond), next.a);
+                } else {
+                    as.emit({0x0F, uint8_t(0x90 | cond), 0xC0});    // setcc al
+                    as.emit({0x0F, 0xB6, 0xF0});                    // movzx esi, al
+                    as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                    as.call(reinterpret_cast<const void*>(&storeBool));
+                }
+                break;
+            }
+            case Op::LtF64:
+            case Op::GtF64:
+            case Op::LeF64:
+            case Op::GeF64:
+            case Op::EqF64:
+            case Op::NeF64:
+                as.memory({0xF2, 0x0F, 0x10}, 0, RBX, slot(in.b));
+                as.memory({0xF2, 0x0F, 0x10}, 1, RBX, slot(in.c));
+                as.call(floatCompares[int(in.op) - int(Op::LtF64)]);
+                if (folded[k + 1]) {
+                    auto& next = code[k + 1];
+                    as.emit({0x85, 0xC0});
+                    jumpTo(as.jump(next.op == Op::JumpIfFalse ? E : NE), next.a);
+                } else {
+                    as.emit({0x89, 0xC6});      // mov esi, eax
+                    as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.a));
+                    as.call(reinterpret_cast<const void*>(&storeBool));
+                }
+                break;
+            case Op::JumpIfFalseI64:
+            case Op::JumpIfTrueI64:
+                as.memory({0x48, 0x83}, 7, RBX, slot(in.b));    // cmp qword [slot], 0
+                as.emit({0x00});
+                jumpTo(as.jump(in.op == Op::JumpIfFalseI64 ? E : NE), in.a);
+                break;
+            case Op::JumpIfFalseF64:
+            case Op::JumpIfTrueF64:
+                // NaN is true, and compares unordered
+                as.memory({0xF2, 0x0F, 0x10}, 0, RBX, slot(in.b));
+                as.emit({0x66, 0x0F, 0x57, 0xC9});      // xorpd xmm1, xmm1
+                as.emit({0x66, 0x0F, 0x2E, 0xC1});      // ucomisd xmm0, xmm1
+                if (in.op == Op::JumpIfFalseF64) {
+                    as.emit({0x7A, 0x06});              // jp over the je
+                    jumpTo(as.jump(E), in.a);
+                } else {
+                    jumpTo(as.jump(P), in.a);
+                    jumpTo(as.jump(NE), in.a);
+                }
+                break;
+            case Op::JumpIfFalse:
+            case Op::JumpIfTrue:
+                as.memory({0x48, 0x8D}, RDI, RBP, boxed(in.b));
+                as.call(reinterpret_cast<const void*>(&truthy));
+                as.emit({0x85, 0xC0});
+                jumpTo(as.jump(in.op == Op::JumpIfFalse ? E : NE), in.a);
+                break;
+            case Op::Jump:
+            case Op::Loop:
+                jumpTo(as.jump(), in.a);
+                break;
+            default:
+                exitAt(k);
+                break;
+        }
+    }
+    labels[n] = as.here();
+    exitAt(n);
+    
+    for (auto& exit : exits) {
+        as.bind(exit.first, as.here());
+        exitAt(exit.second);
+    }
+    size_t epilogue = as.here();
+    as.emit({0x48, 0x83, 0xC4, 0x08, 0x5D, 0x5B, 0xC3});    // add rsp, 8; pop rbp; pop rbx; ret
+    for (size_t field : leaves) as.bind(field, epilogue);
+    for (auto& jump : jumps) as.bind(jump.first, labels[jump.second]);
+    
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (as.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return nullptr;
+    std::memcpy(memory, as.code.data(), as.code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    regions.push_back({memory, size});
+    return reinterpret_cast<bytecode::Specialization::NativeCode>(memory);
+#else
+    (void)module;
+    (void)spec;
+    return nullptr;
+#endif
+}
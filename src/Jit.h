@@ -0,0 +1,33 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_JIT_H
+#define PYTHON_INTERPRETER_JIT_H
+
+#include "Bytecode.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Baseline compiler from specialized bodies to x86-64 machine code, enabled
+// with --jit. Each instruction becomes a fixed template that works on the
+// unboxed slots and registers in memory, so a frame can pass between native
+// code and the interpreter at any instruction. Instructions without a
+// template, and int results that have to deoptimize, return to the
+// interpreter at that instruction; boxing goes through runtime helpers.
+// Elsewhere than x86-64 on a POSIX system nothing is compiled.
+class Jit {
+public:
+    static constexpr int kHotness = 100;    // calls and back edges before compiling
+    
+    Jit() = default;
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+    ~Jit();
+    
+    // Null if the body could not be compiled here
+    bytecode::Specialization::NativeCode compile(const bytecode::Module& module, const bytecode::Specialization& spec);
+
+private:
+    std::vector<std::pair<void*, size_t>> regions;  // executable mappings
+};
+
+#endif//PYTHON_INTERPRETER_JIT_H
@@ -0,0 +1,424 @@
+#include "Lowering.h"
+#include "Python3Lexer.h"
+#include "antlr4-runtime.h"
+
+using namespace ast;
+
+Program Lowering::lower(Python3Parser::File_inputContext *ctx) {
+    Program program;
+    for (auto stmt : ctx->stmt()) {
+        lowerStmt(stmt, program.body);
+    }
+    program.functionNames.resize(functionSlots.size());
+    for (auto& [name, slot] : functionSlots) {
+        program.functionNames[slot] = name;
+    }
+    return program;
+}
+
+// Statements
+void Lowering::lowerStmt(Python3Parser::StmtContext *ctx, Block& out) {
+    if (auto simple = ctx->simple_stmt()) {
+        out.push_back(lowerSimpleStmt(simple));
+        return;
+    }
+    
+    auto compound = ctx->compound_stmt();
+    if (auto ifStmt = compound->if_stmt()) {
+        out.push_back(lowerIfStmt(ifStmt));
+    } else if (auto whileStmt = compound->while_stmt()) {
+        out.push_back(lowerWhileStmt(whileStmt));
+    } else {
+        out.push_back(lowerFuncdef(compound->funcdef()));
+    }
+}
+
+void Lowering::lowerSuite(Python3Parser::SuiteContext *ctx, Block& out) {
+    if (auto simple = ctx->simple_stmt()) {
+        out.push_back(lowerSimpleStmt(simple));
+        return;
+    }
+    for (auto stmt : ctx->stmt()) {
+        lowerStmt(stmt, out);
+    }
+}
+
+StmtPtr Lowering::lowerSimpleStmt(Python3Parser::Simple_stmtContext *ctx) {
+    auto small = ctx->small_stmt();
+    if (auto exprStmt = small->expr_stmt()) {
+        return lowerExprStmt(exprStmt);
+    }
+    return lowerFlowStmt(small->flow_stmt());
+}
+
+StmtPtr Lowering::lowerExprStmt(Python3Parser::Expr_stmtContext *ctx) {
+    auto testlists = ctx->testlist();
+    
+    if (testlists.size() == 1) {
+        return std::make_unique<ExprStmt>(lowerTestlist(testlists[0]));
+    }
+    
+    if (auto aug = ctx->augassign()) {
+        auto stmt = std::make_unique<AugAssignStmt>();
+        if (aug->ADD_ASSIGN()) stmt->op = BinaryOp::Add;
+        else if (aug->SUB_ASSIGN()) stmt->op = BinaryOp::Sub;
+        else if (aug->MULT_ASSIGN()) stmt->op = BinaryOp::Mul;
+        else if (aug->DIV_ASSIGN()) stmt->op = BinaryOp::Div;
+        else if (aug->IDIV_ASSIGN()) stmt->op = BinaryOp::FloorDiv;
+        else stmt->op = BinaryOp::Mod;
+        
+        for (auto test : testlists[0]->test()) {
+            stmt->targets.push_back(targetName(test));
+        }
+        stmt->value = lowerTestlist(testlists[1]);
+        return stmt;
+    }
+    
+    auto stmt = std::make_unique<AssignStmt>();
+    for (size_t i = 0; i + 1 < testlists.size(); i++) {
+        std::vector<std::string> names;
+        for (auto test : testlists[i]->test()) {
+            names.push_back(targetName(test));
+        }
+        stmt->targets.push_back(std::move(names));
+    }
+    stmt->value = lowerTestlist(testlists.back());
+    return stmt;
+}
+
+StmtPtr Lowering::lowerFlowStmt(Python3Parser::Flow_stmtContext *ctx) {
+    if (ctx->break_stmt()) return std::make_unique<BreakStmt>();
+    if (ctx->continue_stmt()) return std::make_unique<ContinueStmt>();
+    
+    auto stmt = std::make_unique<ReturnStmt>();
+    if (auto testlist = ctx->return_stmt()->testlist()) {
+        stmt->value = lowerTestlist(testlist);
+    }
+    return stmt;
+}
+
+StmtPtr Lowering::lowerIfStmt(Python3Parser::If_stmtContext *ctx) {
+    auto stmt = std::make_unique<IfStmt>();
+    auto tests = ctx->test();
+    auto suites = ctx->suite();
+    
+    for (size_t i = 0; i < tests.size(); i++) {
+        stmt->conditions.push_back(lowerTest(tests[i]));
+        stmt->branches.emplace_back();
+        lowerSuite(suites[i], stmt->branches.back());
+    }
+    
+    // else clause
+    if (suites.size() > tests.size()) {
+        lowerSuite(suites.back(), stmt->orelse);
+    }
+    return stmt;
+}
+
+StmtPtr Lowering::lowerWhileStmt(Python3Parser::While_stmtContext *ctx) {
+    auto stmt = std::make_unique<WhileStmt>();
+    stmt->condition = lowerTest(ctx->test());
+    lowerSuite(ctx->suite(), stmt->body);
+    return stmt;
+}
+
+StmtPtr Lowering::lowerFuncdef(Python3Parser::FuncdefContext *ctx) {
+    auto stmt = std::make_unique<FunctionDefStmt>();
+    stmt->name = ctx->NAME()->getText();
+    stmt->function = functionSlot(stmt->name);
+    
+    if (ctx->parameters() && ctx->parameters()->typedargslist()) {
+        auto paramList = ctx->parameters()->typedargslist();
+        for (auto tfpdef : paramList->tfpdef()) {
+            stmt->params.push_back(tfpdef->NAME()->getText());
+        }
+        for (auto test : paramList->test()) {
+            stmt->defaults.push_back(lowerTest(test));
+        }
+    }
+    
+    lowerSuite(ctx->suite(), stmt->body);
+    return stmt;
+}
+
+// Returns the variable name if the test is a bare NAME, otherwise ""
+std::string Lowering::targetName(Python3Parser::TestContext *ctx) {
+    ExprPtr target = lowerTest(ctx);
+    if (target->kind != Expr::Kind::Name) return "";
+    return static_cast<NameExpr&>(*target).name;
+}
+
+int Lowering::functionSlot(const std::string& name) {
+    return functionSlots.emplace(name, functionSlots.size()).first->second;
+}
+
+// Expressions
+ExprPtr Lowering::lowerTest(Python3Parser::TestContext *ctx) {
+    return lowerOrTest(ctx->or_test());
+}
+
+ExprPtr Lowering::lowerOrTest(Python3Parser::Or_testContext *ctx) {
+    auto andTests = ctx->and_test();
+    if (andTests.size() == 1) return lowerAndTest(andTests[0]);
+    
+    auto expr = std::make_unique<LogicalExpr>(LogicalOp::Or);
+    for (auto andTest : andTests) {
+        expr->operands.push_back(lowerAndTest(andTest));
+    }
+    return expr;
+}
+
+ExprPtr Lowering::lowerAndTest(Python3Parser::And_testContext *ctx) {
+    auto notTests = ctx->not_test();
+    if (notTests.size() == 1) return lowerNotTest(notTests[0]);
+    
+    auto expr = std::make_unique<LogicalExpr>(LogicalOp::And);
+    for (auto notTest : notTests) {
+        expr->operands.push_back(lowerNotTest(notTest));
+    }
+    return expr;
+}
+
+ExprPtr Lowering::lowerNotTest(Python3Parser::Not_testContext *ctx) {
+    if (ctx->NOT()) {
+        return std::make_unique<UnaryExpr>(UnaryOp::Not, lowerNotTest(ctx->not_test()));
+    }
+    return lowerComparison(ctx->comparison());
+}
+
+ExprPtr Lowering::lowerComparison(Python3Parser::ComparisonContext *ctx) {
+    auto arithExprs = ctx->arith_expr();
+    if (arithExprs.size() == 1) return lowerArithExpr(arithExprs[0]);
+    
+    auto expr = std::make_unique<CompareExpr>();
+    for (auto arithExpr : arithExprs) {
+        expr->operands.push_back(lowerArithExpr(arithExpr));
+    }
+    for (auto op : ctx->comp_op()) {
+        if (op->LESS_THAN()) expr->ops.push_back(CompareOp::Lt);
+        else if (op->GREATER_THAN()) expr->ops.push_back(CompareOp::Gt);
+        else if (op->LT_EQ()) expr->ops.push_back(CompareOp::Le);
+        else if (op->GT_EQ()) expr->ops.push_back(CompareOp::Ge);
+        else if (op->EQUALS()) expr->ops.push_back(CompareOp::Eq);
+        else expr->ops.push_back(CompareOp::Ne);
+    }
+    return expr;
+}
+
+ExprPtr Lowering::lowerArithExpr(Python3Parser::Arith_exprContext *ctx) {
+    auto terms = ctx->term();
+    auto ops = ctx->addorsub_op();
+    ExprPtr result = lowerTerm(terms[0]);
+    
+    for (size_t i = 1; i < terms.size(); i++) {
+        BinaryOp op = ops[i - 1]->ADD() ? BinaryOp::Add : BinaryOp::Sub;
+        result = std::make_unique<BinaryExpr>(op, std::move(result), lowerTerm(terms[i]));
+    }
+    return result;
+}
+
+ExprPtr Lowering::lowerTerm(Python3Parser::TermContext *ctx) {
+    auto factors = ctx->factor();
+    auto ops = ctx->muldivmod_op();
+    ExprPtr result = lowerFactor(factors[0]);
+    
+    for (size_t i = 1; i < factors.size(); i++) {
+        auto opCtx = ops[i - 1];
+        BinaryOp op;
+        if (opCtx->STAR()) op = BinaryOp::Mul;
+        else if (opCtx->DIV()) op = BinaryOp::Div;
+        else if (opCtx->IDIV()) op = BinaryOp::FloorDiv;
+        else op = BinaryOp::Mod;
+        result = std::make_unique<BinaryExpr>(op, std::move(result), lowerFactor(factors[i]));
+    }
+    return result;
+}
+
+ExprPtr Lowering::lowerFactor(Python3Parser::FactorContext *ctx) {
+    if (ctx->factor()) {
+        ExprPtr operand = lowerFactor(ctx->factor());
+        if (ctx->MINUS()) return std::make_unique<UnaryExpr>(UnaryOp::Neg, std::move(operand));
+        return operand;
+    }
+    return lowerAtomExpr(ctx->atom_expr());
+}
+
+ExprPtr Lowering::lowerAtomExpr(Python3Parser::Atom_exprContext *ctx) {
+    auto trailer = ctx->trailer();
+    if (!trailer) return lowerAtom(ctx->atom());
+    
+    auto call = std::make_unique<CallExpr>();
+    call->callee = ctx->atom()->getText();
+    call->builtin = builtinNamed(call->callee);
+    if (call->builtin == Builtin::None) call->function = functionSlot(call->callee);
+    call->atom = lowerAtom(ctx->atom());
+    
+    if (auto arglist = trailer->arglist()) {
+        for (auto arg : arglist->argument()) {
+            Argument argument;
+            if (arg->test().size() == 2) {
+                // Keyword argument
+                argument.keyword = arg->test(0)->getText();
+                argument.value = lowerTest(arg->test(1));
+            } else {
+                argument.value = lowerTest(arg->test(0));
+            }
+            call->args.push_back(std::move(argument));
+        }
+    }
+    return call;
+}
+
+ExprPtr Lowering::lowerAtom(Python3Parser::AtomContext *ctx) {
+    if (ctx->NONE()) return std::make_unique<ConstantExpr>(Value());
+    if (ctx->TRUE()) return std::make_unique<ConstantExpr>(Value(true));
+    if (ctx->FALSE()) return std::make_unique<ConstantExpr>(Value(false));
+    
+    if (ctx->NAME()) {
+        return std::make_unique<NameExpr>(ctx->NAME()->getText());
+    }
+    
+    if (ctx->NUMBER()) {
+        std::string num = ctx->NUMBER()->getText();
+        if (num.find('.') != std::string::npos) {
+            return std::make_unique<ConstantExpr>(Value(std::stod(num)));
+        }
+        return std::make_unique<ConstantExpr>(Value(BigInt(num)));
+    }
+    
+    if (!ctx->STRING().empty()) return lowerStrings(ctx);
+    if (ctx->test()) return lowerTest(ctx->test());
+    if (ctx->format_string()) return lowerFormatString(ctx->format_string());
+    
+    return std::make_unique<ConstantExpr>(Value());
+}
+
+// Adjacent string literals; once an f-prefixed piece appears the rest of the
+// pieces are formatted as well
+ExprPtr Lowering::lowerStrings(Python3Parser::AtomContext *ctx) {
+    auto fstring = std::make_unique<FStringExpr>();
+    bool isFString = false;
+    
+    for (auto str : ctx->STRING()) {
+        std::string s = str->getText();
+        
+        if (s[0] == 'f' || s[0] == 'F') {
+            isFString = true;
+            s = s.substr(1);
+        }
+        
+        // Remove quotes
+        s = s.substr(1, s.length() - 2);
+        
+        if (isFString) {
+            lowerFStringBody(s, *fstring);
+        } else {
+            appendLiteral(*fstring, s);
+        }
+    }
+    
+    if (fstring->parts.size() == 1 && !fstring->parts[0].expr) {
+        return std::make_unique<ConstantExpr>(Value(fstring->parts[0].literal));
+    }
+    if (fstring->parts.empty()) {
+        return std::make_unique<ConstantExpr>(Value(std::string()));
+    }
+    return fstring;
+}
+
+// Splits the body of an f-prefixed STRING token; each placeholder is parsed
+// with a fresh parser here, once, rather than every time it is evaluated
+void Lowering::lowerFStringBody(const std::string& fstr, FStringExpr& out) {
+    size_t i = 0;
+    
+    while (i < fstr.length()) {
+        if (fstr[i] == '{') {
+            if (i + 1 < fstr.length() && fstr[i + 1] == '{') {
+                appendLiteral(out, "{");
+                i += 2;
+                continue;
+            }
+            
+            // Find matching }
+            int depth = 1;
+            size_t j = i + 1;
+            while (j < fstr.length() && depth > 0) {
+                if (fstr[j] == '{') depth++;
+                else if (fstr[j] == '}') depth--;
+                if (depth > 0) j++;
+            }
+            
+            antlr4::ANTLRInputStream input(fstr.substr(i + 1, j - i - 1));
+            Python3Lexer lexer(&input);
+            antlr4::CommonTokenStream tokens(&lexer);
+            Python3Parser parser(&tokens);
+            out.parts.push_back({"", lowerTest(parser.test())});
+            
+            i = j + 1;
+        } else if (fstr[i] == '}') {
+            if (i + 1 < fstr.length() && fstr[i + 1] == '}') {
+                appendLiteral(out, "}");
+                i += 2;
+            } else {
+                i++;
+            }
+        } else {
+            size_t j = fstr.find_first_of("{}", i);
+            if (j == std::string::npos) j = fstr.length();
+            appendLiteral(out, fstr.substr(i, j - i));
+            i = j;
+        }
+    }
+}
+
+ExprPtr Lowering::lowerFormatString(Python3Parser::Format_stringContext *ctx) {
+    auto fstring = std::make_unique<FStringExpr>();
+    
+    for (size_t i = 0; i < ctx->children.size(); i++) {
+        auto child = ctx->children[i];
+        
+        if (auto testlist = dynamic_cast<Python3Parser::TestlistContext*>(child)) {
+            fstring->parts.push_back({"", lowerTestlist(testlist)});
+            continue;
+        }
+        
+        auto terminal = dynamic_cast<antlr4::tree::TerminalNode*>(child);
+        if (!terminal || terminal->getSymbol()->getType() != Python3Parser::FORMAT_STRING_LITERAL) {
+            // Quotation marks and braces
+            continue;
+        }
+        
+        // Unescape {{ and }}
+        std::string literal = terminal->getText();
+        std::string text;
+        for (size_t j = 0; j < literal.length(); j++) {
+            text += literal[j];
+            if ((literal[j] == '{' || literal[j] == '}') && j + 1 < literal.length() && literal[j + 1] == literal[j]) {
+                j++;
+            }
+        }
+        appendLiteral(*fstring, text);
+    }
+    return fstring;
+}
+
+// Appends literal text, merging it into a preceding literal part
+void Lowering::appendLiteral(FStringExpr& out, const std::string& text) {
+    if (text.empty()) return;
+    if (!out.parts.empty() && !out.parts.back().expr) {
+        out.parts.back().literal += text;
+    } else {
+        out.parts.push_back({text, nullptr});
+    }
+}
+
+ExprPtr Lowering::lowerTestlist(Python3Parser::TestlistContext *ctx) {
+    auto tests = ctx->test();
+    if (tests.size() == 1) return lowerTest(tests[0]);
+    
+    auto tuple = std::make_unique<TupleExpr>();
+    for (auto test : tests) {
+        tuple->elements.push_back(lowerTest(test));
+    }
+    return tuple;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_LOWERING_H
+#define PYTHON_INTERPRETER_LOWERING_H
+
+#include "Python3Parser.h"
+#include "Ast.h"
+#include <map>
+#include <string>
+
+// Converts the ANTLR parse tree into an ast::Program once, before execution
+class Lowering {
+public:
+    ast::Program lower(Python3Parser::File_inputContext *ctx);
+
+private:
+    void lowerStmt(Python3Parser::StmtContext *ctx, ast::Block& out);
+    void lowerSuite(Python3Parser::SuiteContext *ctx, ast::Block& out);
+    ast::StmtPtr lowerSimpleStmt(Python3Parser::Simple_stmtContext *ctx);
+    ast::StmtPtr lowerExprStmt(Python3Parser::Expr_stmtContext *ctx);
+    ast::StmtPtr lowerFlowStmt(Python3Parser::Flow_stmtContext *ctx);
+    ast::StmtPtr lowerIfStmt(Python3Parser::If_stmtContext *ctx);
+    ast::StmtPtr lowerWhileStmt(Python3Parser::While_stmtContext *ctx);
+    ast::StmtPtr lowerFuncdef(Python3Parser::FuncdefContext *ctx);
+    
+    ast::ExprPtr lowerTest(Python3Parser::TestContext *ctx);
+    ast::ExprPtr lowerOrTest(Python3Parser::Or_testContext *ctx);
+    ast::ExprPtr lowerAndTest(Python3Parser::And_testContext *ctx);
+    ast::ExprPtr lowerNotTest(Python3Parser::Not_testContext *ctx);
+    ast::ExprPtr lowerComparison(Python3Parser::ComparisonContext *ctx);
+    ast::ExprPtr lowerArithExpr(Python3Parser::Arith_exprContext *ctx);
+    ast::ExprPtr lowerTerm(Python3Parser::TermContext *ctx);
+    ast::ExprPtr lowerFactor(Python3Parser::FactorContext *ctx);
+    ast::ExprPtr lowerAtomExpr(Python3Parser::Atom_exprContext *ctx);
+    ast::ExprPtr lowerAtom(Python3Parser::AtomContext *ctx);
+    ast::ExprPtr lowerStrings(Python3Parser::AtomContext *ctx);
+    ast::ExprPtr lowerFormatString(Python3Parser::Format_stringContext *ctx);
+    ast::ExprPtr lowerTestlist(Python3Parser::TestlistContext *ctx);
+    
+    void lowerFStringBody(const std::string& body, ast::FStringExpr& out);
+    static void appendLiteral(ast::FStringExpr& out, const std::string& text);
+    std::string targetName(Python3Parser::TestContext *ctx);
+    int functionSlot(const std::string& name);
+    
+    std::map<std::string, int> functionSlots;
+};
+
+#endif//PYTHON_INTERPRETER_LOWERING_H
@@ -0,0 +1,62 @@
+#include "MemoCache.h"
+#include <cstring>
+
+const Value* MemoCache::find(const std::string& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        missCount++;
+        return nullptr;
+    }
+    hitCount++;
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->second;
+}
+
+void MemoCache::insert(std::string key, Value result) {
+    if (capacity == 0 || index.count(key)) return;
+    if (entries.size() == capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    // The index refers to the key stored in the list node, which never moves
+    entries.emplace_front(std::move(key), std::move(result));
+    index.emplace(entries.front().first, entries.begin());
+}
+
+void MemoCache::clear() {
+    index.clear();
+    entries.clear();
+}
+
+void MemoCache::appendKey(std::string& out, const Value& v) {
+    out += static_cast<char>(v.type);
+    switch (v.type) {
+        case Value::BOOL:
+            out += v.boolVal ? '1' : '0';
+            break;
+        case Value::INT:
+            v.intVal.appendTo(out);
+            out += ';';
+            break;
+        case Value::FLOAT: {
+            char bytes[sizeof(double)];
+            std::memcpy(bytes, &v.floatVal, sizeof(double));
+            out.append(bytes, sizeof(double));
+            break;
+        }
+        case Value::STRING:
+            out += std::to_string(v.strVal.size());
+            out += ':';
+            out += v.strVal;
+            break;
+        case Value::TUPLE:
+            out += std::to_string(v.tupleVal.size());
+            out += ':';
+            for (size_t i = 0; i < v.tupleVal.size(); i++) {
+                appendKey(out, v.tupleVal[i]);
+            }
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_MEMOCACHE_H
+#define PYTHON_INTERPRETER_MEMOCACHE_H
+
+#include "Value.h"
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Results of one pure function, keyed by an exact encoding of its argument
+// values. Holds at most capacity entries and evicts the least recently used.
+class MemoCache {
+public:
+    explicit MemoCache(size_t capacity) : capacity(capacity) {}
+    
+    // Returns the cached result for key, or null; counts a hit or a miss
+    const Value* find(const std::string& key);
+    void insert(std::string key, Value result);
+    void clear();
+    
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+    
+    // Appends an encoding of v that tells apart every pair of values that
+    // could behave differently, e.g. 1, 1.0 and True
+    static void appendKey(std::string& out, const Value& v);
+
+private:
+    using Entry = std::pair<std::string, Value>;
+    
+    size_t capacity;
+    std::list<Entry> entries;   // most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+};
+
+#endif//PYTHON_INTERPRETER_MEMOCACHE_H
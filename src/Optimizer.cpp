@@ -0,0 +1,237 @@
+#include "Optimizer.h"
+#include <algorithm>
+#include <string>
+
+using namespace ast;
+
+namespace {
+
+bool isConstant(const ExprPtr& expr) {
+    return expr->kind == Expr::Kind::Constant;
+}
+
+const Value& constantOf(const ExprPtr& expr) {
+    return static_cast<const ConstantExpr&>(*expr).value;
+}
+
+} // namespace
+
+void Optimizer::optimize(Program& program) {
+    optimizeBlock(program.body);
+}
+
+// Statements
+void Optimizer::optimizeBlock(Block& block) {
+    Block out;
+    for (auto& stmt : block) {
+        switch (stmt->kind) {
+            case Stmt::Kind::Expr:
+                fold(static_cast<ExprStmt&>(*stmt).expr);
+                break;
+            case Stmt::Kind::Assign:
+                fold(static_cast<AssignStmt&>(*stmt).value);
+                break;
+            case Stmt::Kind::AugAssign:
+                fold(static_cast<AugAssignStmt&>(*stmt).value);
+                break;
+            case Stmt::Kind::If:
+                optimizeIf(std::move(stmt), out);
+                continue;
+            case Stmt::Kind::While: {
+                auto& whileStmt = static_cast<WhileStmt&>(*stmt);
+                fold(whileStmt.condition);
+                if (isConstant(whileStmt.condition)) {
+                    if (!constantOf(whileStmt.condition).toBool()) continue;
+                    // The engines test a constant True condition for free
+                    whileStmt.condition = std::make_unique<ConstantExpr>(Value(true));
+                }
+                optimizeBlock(whileStmt.body);
+                break;
+            }
+            case Stmt::Kind::Return: {
+                auto& ret = static_cast<ReturnStmt&>(*stmt);
+                if (ret.value) fold(ret.value);
+                break;
+            }
+            case Stmt::Kind::FunctionDef: {
+                auto& def = static_cast<FunctionDefStmt&>(*stmt);
+                for (auto& value : def.defaults) {
+                    fold(value);
+                }
+                optimizeBlock(def.body);
+                break;
+            }
+            default:
+                break;
+        }
+        
+        Stmt::Kind kind = stmt->kind;
+        out.push_back(std::move(stmt));
+        // Nothing after a jump out of the block can run
+        if (kind == Stmt::Kind::Return || kind == Stmt::Kind::Break || kind == Stmt::Kind::Continue) break;
+    }
+    block = std::move(out);
+}
+
+// Drops arms whose condition is constant false and turns the first constant
+// true arm into the else branch; an if left without arms is replaced by the
+// statements of its else branch
+void Optimizer::optimizeIf(StmtPtr stmt, Block& out) {
+    auto& ifStmt = static_cast<IfStmt&>(*stmt);
+    std::vector<ExprPtr> conditions;
+    std::vector<Block> branches;
+    Block orelse = std::move(ifStmt.orelse);
+    
+    for (size_t i = 0; i < ifStmt.conditions.size(); i++) {
+        fold(ifStmt.conditions[i]);
+        if (isConstant(ifStmt.conditions[i])) {
+            if (!constantOf(ifStmt.conditions[i]).toBool()) continue;
+            orelse = std::move(ifStmt.branches[i]);
+            break;
+        }
+        conditions.push_back(std::move(ifStmt.conditions[i]));
+        branches.push_back(std::move(ifStmt.branches[i]));
+    }
+    
+    for (auto& branch : branches) {
+        optimizeBlock(branch);
+    }
+    optimizeBlock(orelse);
+    
+    if (conditions.empty()) {
+        for (auto& inner : orelse) {
+            out.push_back(std::move(inner));
+        }
+        return;
+    }
+    ifStmt.conditions = std::move(conditions);
+    ifStmt.branches = std::move(branches);
+    ifStmt.orelse = std::move(orelse);
+    out.push_back(std::move(stmt));
+}
+
+// Expressions
+void Optimizer::fold(ExprPtr& expr) {
+    switch (expr->kind) {
+        case Expr::Kind::Constant:
+        case Expr::Kind::Name:
+            return;
+        case Expr::Kind::Unary: {
+            auto& unary = static_cast<UnaryExpr&>(*expr);
+            fold(unary.operand);
+            if (!isConstant(unary.operand)) return;
+            const Value& operand = constantOf(unary.operand);
+            Value result = unary.op == UnaryOp::Not ? Value(!operand.toBool()) : -operand;
+            expr = std::make_unique<ConstantExpr>(std::move(result));
+            return;
+        }
+        case Expr::Kind::Binary: {
+            auto& binary = static_cast<BinaryExpr&>(*expr);
+            fold(binary.left);
+            fold(binary.right);
+            if (!isConstant(binary.left) || !isConstant(binary.right)) return;
+            const Value& left = constantOf(binary.left);
+            const Value& right = constantOf(binary.right);
+            if (!foldable(binary.op, left, right)) return;
+            expr = std::make_unique<ConstantExpr>(applyBinary(binary.op, left, right));
+            return;
+        }
+        case Expr::Kind::Compare: {
+            auto& compare = static_cast<CompareExpr&>(*expr);
+            bool constant = true;
+            for (auto& operand : compare.operands) {
+                fold(operand);
+                constant = constant && isConstant(operand);
+            }
+            if (!constant) return;
+            bool result = true;
+            for (size_t i = 0; i < compare.ops.size() && result; i++) {
+                result = applyCompare(compare.ops[i], constantOf(compare.operands[i]),
+                                      constantOf(compare.operands[i + 1]));
+            }
+            expr = std::make_unique<ConstantExpr>(Value(result));
+            return;
+        }
+        case Expr::Kind::Logical:
+            foldLogical(expr);
+            return;
+        case Expr::Kind::Call:
+            for (auto& arg : static_cast<CallExpr&>(*expr).args) {
+                fold(arg.value);
+            }
+            return;
+        case Expr::Kind::Tuple:
+            for (auto& element : static_cast<TupleExpr&>(*expr).elements) {
+                fold(element);
+            }
+            return;
+        case Expr::Kind::FString: {
+            // Constant placeholders become literal text
+            auto& fstring = static_cast<FStringExpr&>(*expr);
+            std::vector<FStringExpr::Part> parts;
+            for (auto& part : fstring.parts) {
+                if (part.expr) fold(part.expr);
+                if (part.expr && !isConstant(part.expr)) {
+                    parts.push_back(std::move(part));
+                    continue;
+                }
+                if (parts.empty() || parts.back().expr) parts.push_back({"", nullptr});
+                if (part.expr) constantOf(part.expr).appendTo(parts.back().literal);
+                else parts.back().literal += part.literal;
+            }
+            if (parts.size() == 1 && !parts[0].expr) {
+                expr = std::make_unique<ConstantExpr>(Value(parts[0].literal));
+                return;
+            }
+            fstring.parts = std::move(parts);
+            return;
+        }
+    }
+}
+
+// A constant operand either ends the chain, when its truth value decides it,
+// or is passed over and can be dropped unless it is the last operand
+void Optimizer::foldLogical(ExprPtr& expr) {
+    auto& logical = static_cast<LogicalExpr&>(*expr);
+    bool decidingTruth = logical.op == LogicalOp::Or;
+    std::vector<ExprPtr> operands;
+    
+    for (size_t i = 0; i < logical.operands.size(); i++) {
+        ExprPtr& operand = logical.operands[i];
+        fold(operand);
+        bool last = i + 1 == logical.operands.size();
+        if (isConstant(operand) && !last) {
+            if (constantOf(operand).toBool() != decidingTruth) continue;
+            operands.push_back(std::move(operand));
+            break;
+        }
+        operands.push_back(std::move(operand));
+    }
+    
+    if (operands.size() == 1) {
+        expr = std::move(operands[0]);
+        return;
+    }
+    logical.operands = std::move(operands);
+}
+
+// Division by zero is left to fail at run time, and string repetition is only
+// folded while the result stays small
+bool Optimizer::foldable(BinaryOp op, const Value& left, const Value& right) {
+    switch (op) {
+        case BinaryOp::Div:
+        case BinaryOp::FloorDiv:
+        case BinaryOp::Mod:
+            return right.toBool();
+        case BinaryOp::Mul: {
+            const Value* text = left.type == Value::STRING ? &left : right.type == Value::STRING ? &right : nullptr;
+            const Value& count = text == &left ? right : left;
+            if (!text || count.type != Value::INT) return true;
+            if (count.intVal > BigInt(static_cast<long long>(kMaxFoldedString))) return false;
+            long long times = std::max(0LL, std::stoll(count.intVal.toString()));
+            return text->strVal.size() * times <= kMaxFoldedString;
+        }
+        default:
+            return true;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_OPTIMIZER_H
+#define PYTHON_INTERPRETER_OPTIMIZER_H
+
+#include "Ast.h"
+
+// Simplifies a lowered ast::Program before it runs. Operators whose operands
+// are all constants are evaluated with Value's own semantics, if arms with
+// constant conditions are resolved, loops that never run are dropped, and
+// statements after a return, break or continue are removed.
+class Optimizer {
+public:
+    static constexpr size_t kMaxFoldedString = 4096;
+    
+    void optimize(ast::Program& program);
+
+private:
+    void optimizeBlock(ast::Block& block);
+    void optimizeIf(ast::StmtPtr stmt, ast::Block& out);
+    void fold(ast::ExprPtr& expr);
+    void foldLogical(ast::ExprPtr& expr);
+    static bool foldable(ast::BinaryOp op, const Value& left, const Value& right);
+};
+
+#endif//PYTHON_INTERPRETER_OPTIMIZER_H
@@ -0,0 +1,315 @@
+#include "Specializer.h"
+
+using bytecode::Op;
+
+namespace {
+
+bool isArithmetic(Op op) {
+    return op >= Op::Add && op <= Op::Mod;
+}
+
+bool isComparison(Op op) {
+    return op >= Op::Lt && op <= Op::Ne;
+}
+
+// The typed forms that leave the specialized body when an int overflows
+bool canDeoptimize(Op op) {
+    return (op >= Op::AddI64 && op <= Op::ModI64Boxed);
+}
+
+} // namespace
+
+void Specializer::specialize(bytecode::Module& mod) {
+    module = &mod;
+    for (auto& function : mod.functions) {
+        specialize(function);
+    }
+}
+
+void Specializer::specialize(bytecode::FunctionCode& code) {
+    function = &code;
+    findDefinitions();
+    findReaching();
+    joinWebs();
+    infer();
+    
+    // Whatever is still unconstrained stays boxed, which may box more
+    bool unboxed = false;
+    for (Kind& kind : kinds) {
+        if (kind == Kind::Unknown) kind = Kind::Boxed;
+    }
+    infer();
+    for (size_t def = 0; def < definitionReg.size(); def++) {
+        if (kindOf(find(def)) != Kind::Boxed) unboxed = true;
+    }
+    if (!unboxed) return;
+    
+    auto spec = std::make_unique<bytecode::Specialization>();
+    spec->body = code.body;
+    spec->exits.resize(code.body.code.size());
+    for (size_t at = 0; at < spec->body.code.size(); at++) {
+        if (reaching[at].empty()) continue;
+        rewrite(spec->body.code[at], at);
+        if (canDeoptimize(spec->body.code[at].op)) spec->exits[at] = unboxedAt(at);
+    }
+    for (size_t i = 0; i < code.params.size(); i++) {
+        spec->params.push_back(regKind(kindOf(find(i))));
+    }
+    code.specialized = std::move(spec);
+}
+
+// The entry defines every register, definition reg for register reg; each
+// instruction then defines the registers it writes
+void Specializer::findDefinitions() {
+    size_t numRegs = function->body.numRegs;
+    auto& code = function->body.code;
+    std::vector<int> reads, writes;
+    
+    definitionReg.clear();
+    definitionsOf.assign(numRegs, {});
+    definitionsAt.assign(code.size(), {});
+    for (size_t reg = 0; reg < numRegs; reg++) {
+        definitionsOf[reg].push_back(definitionReg.size());
+        definitionReg.push_back(reg);
+    }
+    for (size_t at = 0; at < code.size(); at++) {
+        bytecode::operands(*module, code[at], reads, writes);
+        for (int reg : writes) {
+            definitionsOf[reg].push_back(definitionReg.size());
+            definitionsAt[at].push_back(definitionReg.size());
+            definitionReg.push_back(reg);
+        }
+    }
+}
+
+// Which definitions reach each instruction, by a forward dataflow over the
+// body; instructions it never reaches keep an empty set
+void Specializer::findReaching() {
+    auto& code = function->body.code;
+    size_t words = (definitionReg.size() + 63) / 64;
+    std::vector<size_t> worklist, next;
+    
+    reaching.assign(code.size(), {});
+    if (code.empty()) return;
+    reaching[0].assign(words, 0);
+    for (size_t reg = 0; reg < definitionsOf.size(); reg++) {
+        reaching[0][reg / 64] |= uint64_t(1) << (reg % 64);
+    }
+    worklist.push_back(0);
+    while (!worklist.empty()) {
+        size_t at = worklist.back();
+        worklist.pop_back();
+        std::vector<uint64_t> out = reaching[at];
+        for (int def : definitionsAt[at]) {
+            for (int killed : definitionsOf[definitionReg[def]]) {
+                out[killed / 64] &= ~(uint64_t(1) << (killed % 64));
+            }
+        }
+        for (int def : definitionsAt[at]) {
+            out[def / 64] |= uint64_t(1) << (def % 64);
+        }
+        bytecode::successors(code[at], at, next);
+        for (size_t succ : next) {
+            if (succ >= code.size()) continue;
+            auto& in = reaching[succ];
+            bool grew = in.empty();
+            if (grew) in.assign(words, 0);
+            for (size_t w = 0; w < words; w++) {
+                if (out[w] & ~in[w]) {
+                    in[w] |= out[w];
+                    grew = true;
+                }
+            }
+            if (grew) worklist.push_back(succ);
+        }
+    }
+}
+
+// Definitions that reach a common use belong to one web; parameters start
+// out unconstrained and the other locals as None
+void Specializer::joinWebs() {
+    auto& code = function->body.code;
+    std::vector<int> reads, writes;
+    
+    webs.resize(definitionReg.size());
+    for (size_t def = 0; def < webs.size(); def++) {
+        webs[def] = def;
+    }
+    for (size_t at = 0; at < code.size(); at++) {
+        if (reaching[at].empty()) continue;
+        bytecode::operands(*module, code[at], reads, writes);
+        for (int reg : reads) {
+            int web = -1;
+            for (int def : definitionsOf[reg]) {
+                if (!(reaching[at][def / 64] >> (def % 64) & 1)) continue;
+                if (web < 0) web = find(def);
+                else webs[find(def)] = web;
+            }
+        }
+    }
+    
+    kinds.assign(definitionReg.size(), Kind::Unknown);
+    for (size_t reg = function->params.size(); reg < definitionsOf.size(); reg++) {
+        kinds[find(reg)] = Kind::Boxed;
+    }
+}
+
+// Narrows the kinds until every instruction's constraints hold; kinds only
+// move from Unknown to Int or Float to Boxed, so this terminates
+void Specializer::infer() {
+    auto& code = function->body.code;
+    std::vector<int> reads, writes;
+    do {
+        changed = false;
+        for (size_t at = 0; at < code.size(); at++) {
+            auto& in = code[at];
+            if (reaching[at].empty()) continue;
+            if (in.op == Op::LoadConst) {
+                join(writeWeb(at, in.a), constantKind(in.b));
+            } else if (in.op == Op::Copy || in.op == Op::Move) {
+                // A boxed register may take a copy of an unboxed one
+                int source = readWeb(at, in.b);
+                int target = writeWeb(at, in.a);
+                if (kindOf(source) != Kind::Unknown) join(target, kindOf(source));
+                else if (kindOf(target) != Kind::Boxed) join(source, kindOf(target));
+            } else if (isArithmetic(in.op) || isComparison(in.op)) {
+                // Both operands share a kind; an unboxed result may still be
+                // stored boxed
+                int left = readWeb(at, in.b);
+                int right = readWeb(at, in.c);
+                Kind kind = unify(kindOf(left), kindOf(right));
+                if (kind == Kind::Int && in.op == Op::Div) kind = Kind::Boxed;
+                if (kind == Kind::Float && (in.op == Op::FloorDiv || in.op == Op::Mod)) kind = Kind::Boxed;
+                if (kind != Kind::Unknown) {
+                    join(left, kind);
+                    join(right, kind);
+                }
+                if (isComparison(in.op)) join(writeWeb(at, in.a), Kind::Boxed);
+                else if (kind != Kind::Unknown) join(writeWeb(at, in.a), kind);
+            } else if (in.op != Op::JumpIfFalse && in.op != Op::JumpIfTrue && in.op != Op::Return) {
+                bytecode::operands(*module, in, reads, writes);
+                for (int reg : reads) join(readWeb(at, reg), Kind::Boxed);
+                for (int reg : writes) join(writeWeb(at, reg), Kind::Boxed);
+            }
+        }
+    } while (changed);
+}
+
+void Specializer::rewrite(bytecode::Instr& in, size_t at) {
+    // Typed forms by generic opcode, from Add and from Lt; ints have no true
+    // division and floats keep their floor division and modulo generic
+    static const Op intArithmetic[] = {Op::AddI64, Op::SubI64, Op::MulI64, Op::Div, Op::FloorDivI64, Op::ModI64};
+    static const Op intBoxed[] = {Op::AddI64Boxed, Op::SubI64Boxed, Op::MulI64Boxed, Op::Div, Op::FloorDivI64Boxed, Op::ModI64Boxed};
+    static const Op floatArithmetic[] = {Op::AddF64, Op::SubF64, Op::MulF64, Op::DivF64, Op::FloorDiv, Op::Mod};
+    static const Op floatBoxed[] = {Op::AddF64Boxed, Op::SubF64Boxed, Op::MulF64Boxed, Op::DivF64Boxed, Op::FloorDiv, Op::Mod};
+    static const Op intCompare[] = {Op::LtI64, Op::GtI64, Op::LeI64, Op::GeI64, Op::EqI64, Op::NeI64};
+    static const Op floatCompare[] = {Op::LtF64, Op::GtF64, Op::LeF64, Op::GeF64, Op::EqF64, Op::NeF64};
+    
+    if (in.op == Op::LoadConst) {
+        const Value& value = module->constants[in.b];
+        if (writeKind(at, in.a) == Kind::Int) {
+            long long n = 0;
+            value.intVal.toLongLong(n);
+            in.op = Op::LoadI64;
+            in.b = module->intConstants.size();
+            module->intConstants.push_back(n);
+        } else if (writeKind(at, in.a) == Kind::Float) {
+            in.op = Op::LoadF64;
+            in.b = module->floatConstants.size();
+            module->floatConstants.push_back(value.floatVal);
+        }
+    } else if (in.op == Op::Copy || in.op == Op::Move) {
+        Kind kind = readKind(at, in.b);
+        if (kind == Kind::Boxed) return;
+        if (writeKind(at, in.a) == kind) in.op = Op::CopyRaw;
+        else in.op = kind == Kind::Int ? Op::BoxI64 : Op::BoxF64;
+    } else if (isArithmetic(in.op)) {
+        size_t index = static_cast<int>(in.op) - static_cast<int>(Op::Add);
+        bool boxed = writeKind(at, in.a) == Kind::Boxed;
+        if (readKind(at, in.b) == Kind::Int) in.op = boxed ? intBoxed[index] : intArithmetic[index];
+        else if (readKind(at, in.b) == Kind::Float) in.op = boxed ? floatBoxed[index] : floatArithmetic[index];
+    } else if (isComparison(in.op)) {
+        size_t index = static_cast<int>(in.op) - static_cast<int>(Op::Lt);
+        if (readKind(at, in.b) == Kind::Int) in.op = intCompare[index];
+        else if (readKind(at, in.b) == Kind::Float) in.op = floatCompare[index];
+    } else if (in.op == Op::JumpIfFalse || in.op == Op::JumpIfTrue) {
+        bool onFalse = in.op == Op::JumpIfFalse;
+        if (readKind(at, in.b) == Kind::Int) in.op = onFalse ? Op::JumpIfFalseI64 : Op::JumpIfTrueI64;
+        else if (readKind(at, in.b) == Kind::Float) in.op = onFalse ? Op::JumpIfFalseF64 : Op::JumpIfTrueF64;
+    } else if (in.op == Op::Jump && size_t(in.a) <= at) {
+        in.op = Op::Loop;
+    } else if (in.op == Op::Return) {
+        if (readKind(at, in.a) == Kind::Int) in.op = Op::ReturnI64;
+        else if (readKind(at, in.a) == Kind::Float) in.op = Op::ReturnF64;
+    }
+}
+
+// The registers whose value is unboxed when the instruction at runs. A
+// register reached by definitions of more than one web is dead there.
+std::vector<bytecode::Specialization::Slot> Specializer::unboxedAt(size_t at) {
+    std::vector<bytecode::Specialization::Slot> slots;
+    for (size_t reg = 0; reg < definitionsOf.size(); reg++) {
+        int web = -1;
+        bool mixed = false;
+        for (int def : definitionsOf[reg]) {
+            if (!(reaching[at][def / 64] >> (def % 64) & 1)) continue;
+            if (web >= 0 && find(def) != web) mixed = true;
+            web = find(def);
+        }
+        if (web >= 0 && !mixed && kindOf(web) != Kind::Boxed) slots.push_back({int(reg), regKind(kindOf(web))});
+    }
+    return slots;
+}
+
+int Specializer::find(int definition) {
+    while (webs[definition] != definition) {
+        webs[definition] = webs[webs[definition]];
+        definition = webs[definition];
+    }
+    return definition;
+}
+
+// The web of the definitions of reg that reach the instruction at
+int Specializer::readWeb(size_t at, int reg) {
+    for (int def : definitionsOf[reg]) {
+        if (reaching[at][def / 64] >> (def % 64) & 1) return find(def);
+    }
+    return -1;
+}
+
+// The web of the definition of reg made by the instruction at
+int Specializer::writeWeb(size_t at, int reg) {
+    for (int def : definitionsAt[at]) {
+        if (definitionReg[def] == reg) return find(def);
+    }
+    return -1;
+}
+
+void Specializer::join(int web, Kind kind) {
+    if (web < 0) return;
+    Kind joined = unify(kinds[web], kind);
+    if (joined != kinds[web]) {
+        kinds[web] = joined;
+        changed = true;
+    }
+}
+
+Specializer::Kind Specializer::unify(Kind left, Kind right) {
+    if (left == Kind::Unknown) return right;
+    if (right == Kind::Unknown || left == right) return left;
+    return Kind::Boxed;
+}
+
+bytecode::RegKind Specializer::regKind(Kind kind) {
+    if (kind == Kind::Int) return bytecode::RegKind::Int;
+    if (kind == Kind::Float) return bytecode::RegKind::Float;
+    return bytecode::RegKind::Boxed;
+}
+
+Specializer::Kind Specializer::constantKind(int index) const {
+    const Value& value = module->constants[index];
+    long long n;
+    if (value.type == Value::INT && value.intVal.toLongLong(n)) return Kind::Int;
+    if (value.type == Value::FLOAT) return Kind::Float;
+    return Kind::Boxed;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_SPECIALIZER_H
+#define PYTHON_INTERPRETER_SPECIALIZER_H
+
+#include "Bytecode.h"
+#include <cstdint>
+#include <vector>
+
+// Infers which values of each function body are always ints or always
+// floats, and gives the function a bytecode::Specialization that keeps them
+// unboxed.
+//
+// Registers are reused for values of different types, so kinds belong to
+// webs: the definitions of a register that reach a common use, found by a
+// reaching-definitions pass. A web is unboxed when every definition in it
+// produces its kind (an int constant that fits in int64, int arithmetic on
+// unboxed ints, a copy of one) and every use of it has a typed form. The
+// function's entry defines each parameter, with the kind its uses give it,
+// and every other local as None.
+class Specializer {
+public:
+    void specialize(bytecode::Module& module);
+
+private:
+    // Unknown webs have no constraint yet; they end up Boxed
+    enum class Kind : uint8_t { Unknown, Int, Float, Boxed };
+    
+    bytecode::Module* module = nullptr;
+    const bytecode::FunctionCode* function = nullptr;
+    std::vector<int> definitionReg;                     // by definition
+    std::vector<std::vector<int>> definitionsOf;        // by register
+    std::vector<std::vector<int>> definitionsAt;        // by instruction, in operands order
+    std::vector<std::vector<uint64_t>> reaching;        // by instruction, a bit per definition
+    std::vector<int> webs;                              // union-find parent by definition
+    std::vector<Kind> kinds;                            // by web root
+    bool changed = false;
+    
+    void specialize(bytecode::FunctionCode& function);
+    void findDefinitions();
+    void findReaching();
+    void joinWebs();
+    void infer();
+    void rewrite(bytecode::Instr& in, size_t at);
+    std::vector<bytecode::Specialization::Slot> unboxedAt(size_t at);
+    
+    int find(int definition);
+    int readWeb(size_t at, int reg);
+    int writeWeb(size_t at, int reg);
+    Kind readKind(size_t at, int reg) { return kindOf(readWeb(at, reg)); }
+    Kind writeKind(size_t at, int reg) { return kindOf(writeWeb(at, reg)); }
+    Kind kindOf(int web) const { return web < 0 ? Kind::Boxed : kinds[web]; }
+    void join(int web, Kind kind);
+    static Kind unify(Kind left, Kind right);
+    static bytecode::RegKind regKind(Kind kind);
+    
+    Kind constantKind(int index) const;
+};
+
+#endif//PYTHON_INTERPRETER_SPECIALIZER_H
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_UNBOXED_H
+#define PYTHON_INTERPRETER_UNBOXED_H
+
+#include "Value.h"
+#include <cstdint>
+
+// Register slot of a specialized body that holds its value unboxed; the VM
+// and the JIT keep one per register, parallel to the boxed registers
+union Unboxed {
+    int64_t i;
+    double f;
+};
+
+// int64 arithmetic of specialized bodies, with Value's floor semantics; false
+// when the result does not fit or the divisor is zero
+inline bool addI64(int64_t a, int64_t b, int64_t& out) {
+    return !__builtin_add_overflow(a, b, &out);
+}
+
+inline bool subI64(int64_t a, int64_t b, int64_t& out) {
+    return !__builtin_sub_overflow(a, b, &out);
+}
+
+inline bool mulI64(int64_t a, int64_t b, int64_t& out) {
+    return !__builtin_mul_overflow(a, b, &out);
+}
+
+inline bool floorDivI64(int64_t a, int64_t b, int64_t& out) {
+    if (b == 0 || (a == INT64_MIN && b == -1)) return false;
+    out = a / b;
+    if (a % b != 0 && (a < 0) != (b < 0)) out--;
+    return true;
+}
+
+inline bool modI64(int64_t a, int64_t b, int64_t& out) {
+    if (b == 0) return false;
+    if (b == -1) {
+        out = 0;
+        return true;
+    }
+    out = a % b;
+    if (out != 0 && (out < 0) != (b < 0)) out += b;
+    return true;
+}
+
+inline Value boxI64(int64_t n) {
+    return Value(BigInt(static_cast<long long>(n)));
+}
+
+#endif//PYTHON_INTERPRETER_UNBOXED_H
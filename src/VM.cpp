@@ -0,0 +1,632 @@
+#include "VM.h"
+#include "Unboxed.h"
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+
+using bytecode::Op;
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+// Each handler ends in DISPATCH(), which either jumps straight to the next
+// instruction's handler or returns to the switch
+#ifdef VM_COMPUTED_GOTO
+#define TARGET(name) op_##name
+#define DISPATCH() do { in = pc++; goto *dispatchTable[static_cast<size_t>(in->op)]; } while (0)
+#else
+#define TARGET(name) case Op::name
+#define DISPATCH() break
+#endif
+
+namespace {
+
+// Rewrites a generic arithmetic or comparison instruction into the form
+// specialized for its operand types; sites that keep changing types stay generic
+inline void quicken(bytecode::Instr& in, const Value& left, const Value& right, Op intOp, Op floatOp, Op strOp) {
+    if (left.type != right.type || in.deopts >= bytecode::Instr::kMaxDeopts) return;
+    switch (left.type) {
+        case Value::INT: in.op = intOp; break;
+        case Value::FLOAT: in.op = floatOp; break;
+        case Value::STRING: in.op = strOp; break;
+        default: break;
+    }
+}
+
+inline void deoptimize(bytecode::Instr& in, Op generic) {
+    in.op = generic;
+    in.deopts++;
+}
+
+// Comparisons derived from < and == exactly as Value's operators derive them
+template <ast::CompareOp op, class T>
+inline bool compareAs(const T& left, const T& right) {
+    switch (op) {
+        case ast::CompareOp::Lt: return left < right;
+        case ast::CompareOp::Gt: return right < left;
+        case ast::CompareOp::Le: return !(right < left);
+        case ast::CompareOp::Ge: return !(left < right);
+        case ast::CompareOp::Eq: return left == right;
+        case ast::CompareOp::Ne: return !(left == right);
+    }
+    return false;
+}
+
+} // namespace
+
+bool VM::run(bytecode::Module& mod) {
+    module = &mod;
+    globals.assign(mod.globalNames.size(), Value());
+    functions.assign(mod.functionNames.size(), Function());
+    memoCaches.clear();
+    memoCaches.resize(mod.functionNames.size());
+    if (memoCapacity > 0) {
+        for (size_t slot = 0; slot < memoCaches.size(); slot++) {
+            if (mod.pureFunctions[slot]) memoCaches[slot] = std::make_unique<MemoCache>(memoCapacity);
+        }
+    }
+    failed = false;
+    execute(mod.main, 0);
+    if (memoCapacity > 0) reportMemoStats();
+    return !failed;
+}
+
+Value VM::execute(bytecode::CodeObject& code, size_t base) {
+    if (registers.size() < base + code.numRegs) {
+        registers.resize(std::max(registers.size() * 2, base + code.numRegs));
+        unboxed.resize(registers.size());
+    }
+    Value* r = registers.data() + base;
+    Unboxed* u = unboxed.data() + base;
+    bytecode::FunctionCode* function = nullptr;
+    bytecode::Instr* first = code.code.data();
+    bytecode::Instr* pc = first;
+    bytecode::Instr* in;
+    size_t entryDepth = callStack.size();
+
+#ifdef VM_COMPUTED_GOTO
+    static const void* const dispatchTable[] = {
+#define BYTECODE_OP_LABEL(name) &&op_##name,
+        BYTECODE_OPS(BYTECODE_OP_LABEL)
+#undef BYTECODE_OP_LABEL
+    };
+    DISPATCH();
+#else
+    for (;;) {
+    in = pc++;
+    switch (in->op) {
+#endif
+
+    TARGET(LoadConst): {
+        r[in->a] = module->constants[in->b];
+        DISPATCH();
+    }
+    TARGET(LoadGlobal): {
+        r[in->a] = globals[in->b];
+        DISPATCH();
+    }
+    TARGET(StoreGlobal): {
+        if (in->c) globals[in->a] = r[in->b];
+        else globals[in->a] = std::move(r[in->b]);
+        DISPATCH();
+    }
+    TARGET(AugGlobal): {
+        Value& target = globals[in->a];
+        target = ast::applyBinary(static_cast<ast::BinaryOp>(in->c), std::move(target), r[in->b]);
+        DISPATCH();
+    }
+    TARGET(UnpackStore): {
+        // A tuple nobody else references can give up its elements
+        Value value = in->c ? r[in->b] : std::move(r[in->b]);
+        if (value.type == Value::TUPLE) {
+            auto& targets = module->targetLists[in->a];
+            Tuple& tuple = *value.tupleVal.get();
+            bool steal = value.tupleVal.unique();
+            for (size_t j = 0; j < targets.size() && j < tuple.size(); j++) {
+                if (targets[j].kind == bytecode::Target::Kind::None) continue;
+                Value& slot = targets[j].kind == bytecode::Target::Kind::Local ? r[targets[j].index] : globals[targets[j].index];
+                if (steal) slot = std::move(tuple[j]);
+                else slot = tuple[j];
+            }
+        }
+        DISPATCH();
+    }
+    TARGET(Copy): {
+        r[in->a] = r[in->b];
+        DISPATCH();
+    }
+    TARGET(Move): {
+        r[in->a] = std::move(r[in->b]);
+        DISPATCH();
+    }
+    TARGET(Add): generic_Add: {
+        quicken(*in, r[in->b], r[in->c], Op::AddInt, Op::AddFloat, Op::AddStr);
+        if (in->a == in->b) r[in->a] = std::move(r[in->b]) + r[in->c];
+        else r[in->a] = r[in->b] + r[in->c];
+        DISPATCH();
+    }
+    TARGET(Sub): generic_Sub: {
+        quicken(*in, r[in->b], r[in->c], Op::SubInt, Op::SubFloat, Op::Sub);
+        if (in->a == in->b) r[in->a] = std::move(r[in->b]) - r[in->c];
+        else r[in->a] = r[in->b] - r[in->c];
+        DISPATCH();
+    }
+    TARGET(Mul): generic_Mul: {
+        quicken(*in, r[in->b], r[in->c], Op::MulInt, Op::MulFloat, Op::Mul);
+        if (in->a == in->b) r[in->a] = std::move(r[in->b]) * r[in->c];
+        else r[in->a] = r[in->b] * r[in->c];
+        DISPATCH();
+    }
+    TARGET(Div): {
+        r[in->a] = r[in->b] / r[in->c];
+        DISPATCH();
+    }
+    TARGET(FloorDiv): generic_FloorDiv: {
+        quicken(*in, r[in->b], r[in->c], Op::FloorDivInt, Op::FloorDiv, Op::FloorDiv);
+        r[in->a] = r[in->b].floordiv(r[in->c]);
+        DISPATCH();
+    }
+    TARGET(Mod): generic_Mod: {
+        quicken(*in, r[in->b], r[in->c], Op::ModInt, Op::Mod, Op::Mod);
+        r[in->a] = r[in->b] % r[in->c];
+        DISPATCH();
+    }
+
+#define GENERIC_COMPARE(name, op) \
+    TARGET(name): generic_##name: { \
+        quicken(*in, r[in->b], r[in->c], Op::name##Int, Op::name##Float, Op::name##Str); \
+        r[in->a] = Value(r[in->b] op r[in->c]); \
+        DISPATCH(); \
+    }
+    GENERIC_COMPARE(Lt, <)
+    GENERIC_COMPARE(Gt, >)
+    GENERIC_COMPARE(Le, <=)
+    GENERIC_COMPARE(Ge, >=)
+    GENERIC_COMPARE(Eq, ==)
+    GENERIC_COMPARE(Ne, !=)
+#undef GENERIC_COMPARE
+
+    TARGET(Not): {
+        r[in->a] = Value(!r[in->b].toBool());
+        DISPATCH();
+    }
+    TARGET(Neg): {
+        if (in->a == in->b) r[in->a] = -std::move(r[in->b]);
+        else r[in->a] = -r[in->b];
+        DISPATCH();
+    }
+    TARGET(Jump): {
+        pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(JumpIfFalse): {
+        if (!r[in->b].toBool()) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(JumpIfTrue): {
+        if (r[in->b].toBool()) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(BuildTuple): {
+        TupleRef tuple = Tuple::make(in->c);
+        for (int i = 0; i < in->c; i++) {
+            (*tuple.get())[i] = std::move(r[in->b + i]);
+        }
+        r[in->a] = Value(std::move(tuple));
+        DISPATCH();
+    }
+    TARGET(Format): {
+        std::string result;
+        for (int i = 0; i < in->c; i++) {
+            r[in->b + i].appendTo(result);
+        }
+        r[in->a] = Value(result);
+        DISPATCH();
+    }
+    TARGET(Print): {
+        print(r + in->b, in->c);
+        r[in->a] = Value();
+        DISPATCH();
+    }
+    TARGET(Convert): {
+        r[in->a] = ast::applyConversion(static_cast<ast::Builtin>(in->c), r[in->b]);
+        DISPATCH();
+    }
+    TARGET(Call): {
+        auto& site = module->callSites[in->b];
+        auto& func = functions[site.function];
+        if (func.code) {
+            if (callStack.size() - entryDepth >= maxDepth) {
+                std::cerr << "RecursionError: maximum recursion depth exceeded" << std::endl;
+                callStack.resize(entryDepth);
+                memoKeys.clear();
+                failed = true;
+                return Value();
+            }
+            // The callee's window starts at the arguments; the register file
+            // may be reallocated, so frames remember offsets
+            size_t offset = r - registers.data();
+            r = enterFrame(func, site, offset + site.firstArg);
+            MemoCache* memo = memoCaches[site.function].get();
+            if (memo) {
+                memoKey.clear();
+                for (size_t i = 0; i < func.code->params.size(); i++) {
+                    MemoCache::appendKey(memoKey, r[i]);
+                }
+                if (const Value* result = memo->find(memoKey)) {
+                    r = registers.data() + offset;
+                    u = unboxed.data() + offset;
+                    r[in->a] = *result;
+                    pc = first + in->c;
+                    DISPATCH();
+                }
+                memoKeys.push_back(memoKey);
+            }
+            callStack.push_back({function, first, in, offset, memo});
+            function = func.code;
+            u = unboxed.data() + offset + site.firstArg;
+            pc = first = bodyFor(*function, r, u);
+            if (jit && function->specialized && first == function->specialized->body.code.data()) {
+                pc = first + enterNative(*function->specialized, r, u, 0);
+            }
+        }
+        // Otherwise fall through to the atom code
+        DISPATCH();
+    }
+    TARGET(TailCall): {
+        auto& site = module->callSites[in->b];
+        auto& func = functions[site.function];
+        if (func.code) {
+            // Slide the arguments down to the start of this window and run the
+            // callee in place of the current function
+            if (site.firstArg > 0) {
+                for (size_t i = 0; i < site.keywords.size(); i++) {
+                    r[i] = std::move(r[site.firstArg + i]);
+                }
+            }
+            size_t offset = r - registers.data();
+            r = enterFrame(func, site, offset);
+            function = func.code;
+            u = unboxed.data() + offset;
+            pc = first = bodyFor(*function, r, u);
+            if (jit && function->specialized && first == function->specialized->body.code.data()) {
+                pc = first + enterNative(*function->specialized, r, u, 0);
+            }
+        }
+        // Otherwise fall through to the atom code
+        DISPATCH();
+    }
+    TARGET(MakeFunction): {
+        auto& funcCode = module->functions[in->a];
+        Function func{&funcCode, {}};
+        for (size_t i = 0; i < funcCode.defaultCount; i++) {
+            func.defaults.push_back(std::move(r[in->b + i]));
+        }
+        functions[funcCode.function] = std::move(func);
+        // Pure results may depend on any function that is now (re)defined
+        for (auto& memo : memoCaches) {
+            if (memo) memo->clear();
+        }
+        DISPATCH();
+    }
+    TARGET(Return): generic_Return: {
+        if (callStack.size() == entryDepth) return std::move(r[in->a]);
+        CallFrame& caller = callStack.back();
+        if (caller.memo) {
+            caller.memo->insert(std::move(memoKeys.back()), r[in->a]);
+            memoKeys.pop_back();
+        }
+        Value* callerRegs = registers.data() + caller.base;
+        callerRegs[caller.call->a] = std::move(r[in->a]);
+        r = callerRegs;
+        u = unboxed.data() + caller.base;
+        function = caller.function;
+        first = caller.first;
+        pc = first + caller.call->c;
+        callStack.pop_back();
+        DISPATCH();
+    }
+    TARGET(Halt): {
+        return Value();
+    }
+    
+    // Quickened forms; a failed guard hands the instruction back to the generic
+    // handler, which may quicken it again for the new types
+#define GUARD(generic, TYPE) \
+    if (r[in->b].type != Value::TYPE || r[in->c].type != Value::TYPE) { \
+        deoptimize(*in, Op::generic); \
+        goto generic_##generic; \
+    }
+    
+    // In place when the result replaces the left operand, as compiled code does
+#define QUICK_ARITHMETIC(name, Suffix, op, TYPE, field) \
+    TARGET(name##Suffix): { \
+        GUARD(name, TYPE); \
+        if (in->a == in->b) r[in->a].field = std::move(r[in->b].field) op r[in->c].field; \
+        else r[in->a] = Value(r[in->b].field op r[in->c].field); \
+        DISPATCH(); \
+    }
+    QUICK_ARITHMETIC(Add, Int, +, INT, intVal)
+    QUICK_ARITHMETIC(Add, Float, +, FLOAT, floatVal)
+    QUICK_ARITHMETIC(Add, Str, +, STRING, strVal)
+    QUICK_ARITHMETIC(Sub, Int, -, INT, intVal)
+    QUICK_ARITHMETIC(Sub, Float, -, FLOAT, floatVal)
+    QUICK_ARITHMETIC(Mul, Int, *, INT, intVal)
+    QUICK_ARITHMETIC(Mul, Float, *, FLOAT, floatVal)
+    QUICK_ARITHMETIC(FloorDiv, Int, /, INT, intVal)
+    QUICK_ARITHMETIC(Mod, Int, %, INT, intVal)
+#undef QUICK_ARITHMETIC
+
+#define QUICK_COMPARE(name, Suffix, TYPE, field) \
+    TARGET(name##Suffix): { \
+        GUARD(name, TYPE); \
+        r[in->a] = Value(compareAs<ast::CompareOp::name>(r[in->b].field, r[in->c].field)); \
+        DISPATCH(); \
+    }
+#define QUICK_COMPARES(name) \
+    QUICK_COMPARE(name, Int, INT, intVal) \
+    QUICK_COMPARE(name, Float, FLOAT, floatVal) \
+    QUICK_COMPARE(name, Str, STRING, strVal)
+    QUICK_COMPARES(Lt)
+    QUICK_COMPARES(Gt)
+    QUICK_COMPARES(Le)
+    QUICK_COMPARES(Ge)
+    QUICK_COMPARES(Eq)
+    QUICK_COMPARES(Ne)
+#undef QUICK_COMPARES
+#undef QUICK_COMPARE
+#undef GUARD
+
+    // Typed forms of specialized bodies, on the unboxed slots u[]
+    TARGET(LoadI64): {
+        u[in->a].i = module->intConstants[in->b];
+        DISPATCH();
+    }
+    TARGET(LoadF64): {
+        u[in->a].f = module->floatConstants[in->b];
+        DISPATCH();
+    }
+    TARGET(CopyRaw): {
+        u[in->a] = u[in->b];
+        DISPATCH();
+    }
+    TARGET(BoxI64): {
+        r[in->a] = boxI64(u[in->b].i);
+        DISPATCH();
+    }
+    TARGET(BoxF64): {
+        r[in->a] = Value(u[in->b].f);
+        DISPATCH();
+    }
+
+#define RAW_INT_ARITHMETIC(name, checked) \
+    TARGET(name##I64): { \
+        int64_t result; \
+        if (!checked(u[in->b].i, u[in->c].i, result)) goto deoptimize_frame; \
+        u[in->a].i = result; \
+        DISPATCH(); \
+    } \
+    TARGET(name##I64Boxed): { \
+        int64_t result; \
+        if (!checked(u[in->b].i, u[in->c].i, result)) goto deoptimize_frame; \
+        r[in->a] = boxI64(result); \
+        DISPATCH(); \
+    }
+    RAW_INT_ARITHMETIC(Add, addI64)
+    RAW_INT_ARITHMETIC(Sub, subI64)
+    RAW_INT_ARITHMETIC(Mul, mulI64)
+    RAW_INT_ARITHMETIC(FloorDiv, floorDivI64)
+    RAW_INT_ARITHMETIC(Mod, modI64)
+#undef RAW_INT_ARITHMETIC
+
+#define RAW_FLOAT_ARITHMETIC(name, op) \
+    TARGET(name##F64): { \
+        u[in->a].f = u[in->b].f op u[in->c].f; \
+        DISPATCH(); \
+    } \
+    TARGET(name##F64Boxed): { \
+        r[in->a] = Value(u[in->b].f op u[in->c].f); \
+        DISPATCH(); \
+    }
+    RAW_FLOAT_ARITHMETIC(Add, +)
+    RAW_FLOAT_ARITHMETIC(Sub, -)
+    RAW_FLOAT_ARITHMETIC(Mul, *)
+    RAW_FLOAT_ARITHMETIC(Div, /)
+#undef RAW_FLOAT_ARITHMETIC
+
+#define RAW_COMPARE(name) \
+    TARGET(name##I64): { \
+        r[in->a] = Value(compareAs<ast::CompareOp::name>(u[in->b].i, u[in->c].i)); \
+        DISPATCH(); \
+    } \
+    TARGET(name##F64): { \
+        r[in->a] = Value(compareAs<ast::CompareOp::name>(u[in->b].f, u[in->c].f)); \
+        DISPATCH(); \
+    }
+    RAW_COMPARE(Lt)
+    RAW_COMPARE(Gt)
+    RAW_COMPARE(Le)
+    RAW_COMPARE(Ge)
+    RAW_COMPARE(Eq)
+    RAW_COMPARE(Ne)
+#undef RAW_COMPARE
+
+    TARGET(JumpIfFalseI64): {
+        if (u[in->b].i == 0) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(JumpIfTrueI64): {
+        if (u[in->b].i != 0) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(JumpIfFalseF64): {
+        if (u[in->b].f == 0.0) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(JumpIfTrueF64): {
+        if (u[in->b].f != 0.0) pc = first + in->a;
+        DISPATCH();
+    }
+    TARGET(Loop): {
+        pc = first + in->a;
+        if (jit) pc = first + enterNative(*function->specialized, r, u, in->a);
+        DISPATCH();
+    }
+    TARGET(ReturnI64): {
+        r[in->a] = boxI64(u[in->a].i);
+        goto generic_Return;
+    }
+    TARGET(ReturnF64): {
+        r[in->a] = Value(u[in->a].f);
+        goto generic_Return;
+    }
+    
+    // An int result the frame cannot hold unboxed: box the registers that are
+    // unboxed here and redo the instruction in the generic body, which has the
+    // same layout
+    deoptimize_frame: {
+        auto& spec = *function->specialized;
+        spec.deopts++;
+        for (auto& slot : spec.exits[in - first]) {
+            if (slot.kind == bytecode::RegKind::Int) r[slot.reg] = boxI64(u[slot.reg].i);
+            else r[slot.reg] = Value(u[slot.reg].f);
+        }
+        pc = function->body.code.data() + (in - first);
+        first = function->body.code.data();
+        DISPATCH();
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    }
+    }
+#endif
+}
+
+#undef TARGET
+#undef DISPATCH
+
+// Binds the arguments at the start of the window at base to the function's
+// parameter slots and clears its other locals
+Value* VM::enterFrame(const Function& func, bytecode::CallSite& site, size_t base) {
+    auto& body = func.code->body;
+    if (registers.size() < base + body.numRegs) {
+        registers.resize(std::max(registers.size() * 2, base + body.numRegs));
+        unboxed.resize(registers.size());
+    }
+    Value* frame = registers.data() + base;
+    if (site.boundCallee != func.code) bindCallSite(site, *func.code);
+    
+    // Keyword or surplus arguments are moved into their slots through a
+    // scratch buffer, since the slots overlap the argument registers
+    if (!site.inPlace) {
+        size_t argc = site.argSlots.size();
+        scratch.resize(argc);
+        for (size_t i = 0; i < argc; i++) {
+            scratch[i] = std::move(frame[i]);
+        }
+        for (size_t i = 0; i < argc; i++) {
+            if (site.argSlots[i] >= 0) frame[site.argSlots[i]] = std::move(scratch[i]);
+        }
+    }
+    
+    // Parameters without an argument take their prebuilt default or None, and
+    // the other locals start out as None
+    size_t defaultStart = func.code->params.size() - func.defaults.size();
+    for (int slot : site.unboundSlots) {
+        if (size_t(slot) >= defaultStart) frame[slot] = func.defaults[slot - defaultStart];
+        else frame[slot] = Value();
+    }
+    for (int i = func.code->params.size(); i < func.code->numLocals; i++) {
+        frame[i] = Value();
+    }
+    return frame;
+}
+
+// Unboxes the parameters a specialized body keeps raw and returns the code a
+// call of the function starts in: the generic body if an argument does not fit
+bytecode::Instr* VM::bodyFor(bytecode::FunctionCode& code, const Value* frame, Unboxed* raw) {
+    auto* spec = code.specialized.get();
+    if (!spec || spec->deopts >= bytecode::Specialization::kMaxDeopts) return code.body.code.data();
+    for (size_t i = 0; i < code.params.size(); i++) {
+        switch (spec->params[i]) {
+            case bytecode::RegKind::Int: {
+                long long n;
+                if (frame[i].type != Value::INT || !frame[i].intVal.toLongLong(n)) return code.body.code.data();
+                raw[i].i = n;
+                break;
+            }
+            case bytecode::RegKind::Float:
+                if (frame[i].type != Value::FLOAT) return code.body.code.data();
+                raw[i].f = frame[i].floatVal;
+                break;
+            case bytecode::RegKind::Boxed:
+                break;
+        }
+    }
+    return spec->body.code.data();
+}
+
+// Runs a specialized body natively from instruction entry, compiling it once
+// it is hot, and returns the instruction to go on interpreting at
+int VM::enterNative(bytecode::Specialization& spec, Value* frame, Unboxed* raw, int entry) {
+    if (!spec.native) {
+        if (spec.compiled || ++spec.hotness < Jit::kHotness) return entry;
+        spec.compiled = true;
+        spec.native = jit->compile(*module, spec);
+        if (!spec.native) return entry;
+    }
+    return spec.native(raw, frame, entry);
+}
+
+// Works out once per call site and callee which parameter slot each argument
+// binds to; a later argument for the same parameter wins
+void VM::bindCallSite(bytecode::CallSite& site, const bytecode::FunctionCode& callee) {
+    auto& params = callee.params;
+    std::vector<char> bound(params.size(), 0);
+    size_t posArgCount = 0;
+    
+    site.boundCallee = &callee;
+    site.inPlace = true;
+    site.argSlots.clear();
+    for (size_t i = 0; i < site.keywords.size(); i++) {
+        int slot = -1;
+        if (site.keywords[i] >= 0) {
+            auto param = std::find(params.begin(), params.end(), site.keywords[i]);
+            if (param != params.end()) slot = param - params.begin();
+        } else if (posArgCount < params.size()) {
+            slot = posArgCount++;
+        }
+        if (slot >= 0) bound[slot] = 1;
+        if (slot != int(i)) site.inPlace = false;
+        site.argSlots.push_back(slot);
+    }
+    
+    site.unboundSlots.clear();
+    for (size_t i = 0; i < params.size(); i++) {
+        if (!bound[i]) site.unboundSlots.push_back(i);
+    }
+}
+
+void VM::print(const Value* args, size_t count) {
+    // Format the whole line into a reused buffer and write it once
+    printBuffer.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) printBuffer += ' ';
+        args[i].appendTo(printBuffer);
+    }
+    printBuffer += '\n';
+    std::cout.write(printBuffer.data(), printBuffer.size());
+}
+
+void VM::reportMemoStats() const {
+    for (size_t slot = 0; slot < memoCaches.size(); slot++) {
+        auto& memo = memoCaches[slot];
+        if (!memo || memo->hits() + memo->misses() == 0) continue;
+        size_t calls = memo->hits() + memo->misses();
+        char rate[16];
+        std::snprintf(rate, sizeof(rate), "%.1f%%", 100.0 * memo->hits() / calls);
+        std::cerr << "memo " << module->functionNames[slot] << ": " << memo->hits() << " hits, "
+                  << memo->misses() << " misses, " << rate << " hit rate" << std::endl;
+    }
+}
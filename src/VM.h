@@ -0,0 +1,86 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_VM_H
+#define PYTHON_INTERPRETER_VM_H
+
+#include "Bytecode.h"
+#include "Jit.h"
+#include "MemoCache.h"
+#include "Unboxed.h"
+#include "Value.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Executes a bytecode::Module in a single dispatch loop. Calls push a record
+// on a heap-allocated call stack rather than recursing natively, so the
+// recursion depth is bounded only by maxDepth. Built with GCC or Clang the
+// loop is threaded through computed goto; defining VM_SWITCH_DISPATCH selects
+// the portable switch.
+//
+// Functions with a specialized body run it whenever their unboxed parameters
+// fit, keeping those registers' values in a parallel file of raw slots. With
+// a Jit, bodies whose calls and back edges pass Jit::kHotness run natively.
+//
+// With a nonzero memoCapacity, calls of functions the compiler found pure are
+// answered from a per-function MemoCache; hit rates go to stderr at the end.
+class VM {
+public:
+    static constexpr size_t kDefaultMaxDepth = 100000;
+    static constexpr size_t kDefaultMemoCapacity = 4096;
+    
+    explicit VM(size_t maxDepth = kDefaultMaxDepth, size_t memoCapacity = 0, bool jit = false)
+        : maxDepth(maxDepth), memoCapacity(memoCapacity), jit(jit ? std::make_unique<Jit>() : nullptr) {}
+    
+    // Returns false if the program was stopped by a runtime error
+    bool run(bytecode::Module& module);
+
+private:
+    // Runtime record of a def statement; defaults are evaluated when it runs
+    struct Function {
+        bytecode::FunctionCode* code = nullptr;
+        std::vector<Value> defaults;
+    };
+    
+    // Where a call returns to: the caller's function and code, its Call
+    // instruction and the start of its register window. A memoized call's key
+    // is on memoKeys.
+    struct CallFrame {
+        bytecode::FunctionCode* function;
+        bytecode::Instr* first;
+        bytecode::Instr* call;
+        size_t base;
+        MemoCache* memo;
+    };
+    
+    
+    bytecode::Module* module = nullptr;
+    std::vector<Value> globals;
+    std::vector<Function> functions;    // by function slot; code is null until defined
+    std::string printBuffer;
+    
+    // Register windows of all active calls; each call's window starts at the
+    // argument registers of its call site in the caller's window
+    std::vector<Value> registers;
+    std::vector<Unboxed> unboxed;       // parallel to registers
+    std::vector<Value> scratch;
+    std::vector<CallFrame> callStack;
+    size_t maxDepth;
+    
+    // Caches of the pure functions by function slot, null for the others
+    std::vector<std::unique_ptr<MemoCache>> memoCaches;
+    std::vector<std::string> memoKeys;
+    std::string memoKey;
+    size_t memoCapacity;
+    std::unique_ptr<Jit> jit;       // null unless enabled
+    bool failed = false;
+    
+    Value execute(bytecode::CodeObject& code, size_t base);
+    Value* enterFrame(const Function& func, bytecode::CallSite& site, size_t base);
+    static bytecode::Instr* bodyFor(bytecode::FunctionCode& code, const Value* frame, Unboxed* raw);
+    int enterNative(bytecode::Specialization& spec, Value* frame, Unboxed* raw, int entry);
+    static void bindCallSite(bytecode::CallSite& site, const bytecode::FunctionCode& callee);
+    void print(const Value* args, size_t count);
+    void reportMemoStats() const;
+};
+
+#endif//PYTHON_INTERPRETER_VM_H
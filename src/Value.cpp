@@ -0,0 +1,599 @@
+#include "Value.h"
+#include <stdexcept>
+#include <charconv>
+#include <cmath>
+
+// BigInt Implementation
+void BigInt::normalize() {
+    // Remove leading zeros
+    size_t pos = value.find_first_not_of('0');
+    if (pos == std::string::npos) {
+        value.assign(1, '0');
+        negative = false;
+    } else if (pos > 0) {
+        value.erase(0, pos);
+    }
+    if (value == "0") negative = false;
+}
+
+BigInt::BigInt() : value("0"), negative(false) {}
+
+BigInt::BigInt(const std::string& s) {
+    if (s.empty() || s == "-") {
+        value = "0";
+        negative = false;
+        return;
+    }
+    
+    size_t start = 0;
+    negative = false;
+    if (s[0] == '-') {
+        negative = true;
+        start = 1;
+    } else if (s[0] == '+') {
+        start = 1;
+    }
+    
+    value = s.substr(start);
+    normalize();
+}
+
+BigInt::BigInt(long long n) {
+    // The magnitude is taken unsigned so that LLONG_MIN does not overflow
+    negative = n < 0;
+    value = std::to_string(negative ? 0ULL - (unsigned long long)n : (unsigned long long)n);
+    normalize();
+}
+
+BigInt::BigInt(int n) : BigInt((long long)n) {}
+
+// a += b on magnitudes
+void BigInt::addInPlace(std::string& a, const std::string& b) {
+    if (a.length() < b.length()) a.insert(0, b.length() - a.length(), '0');
+    
+    int carry = 0;
+    size_t i = a.length();
+    size_t j = b.length();
+    while (i > 0 && (j > 0 || carry)) {
+        int sum = (a[--i] - '0') + carry;
+        if (j > 0) sum += b[--j] - '0';
+        a[i] = char('0' + sum % 10);
+        carry = sum / 10;
+    }
+    if (carry) a.insert(a.begin(), '1');
+}
+
+// a -= b on magnitudes, assumes a >= b
+void BigInt::subtractInPlace(std::string& a, const std::string& b) {
+    int borrow = 0;
+    size_t i = a.length();
+    size_t j = b.length();
+    while (i > 0 && (j > 0 || borrow)) {
+        int diff = (a[--i] - '0') - borrow;
+        if (j > 0) diff -= b[--j] - '0';
+        
+        if (diff < 0) {
+            diff += 10;
+            borrow = 1;
+        } else {
+            borrow = 0;
+        }
+        a[i] = char('0' + diff);
+    }
+    
+    // Remove leading zeros
+    size_t pos = a.find_first_not_of('0');
+    if (pos == std::string::npos) a.assign(1, '0');
+    else if (pos > 0) a.erase(0, pos);
+}
+
+// a = b - a on magnitudes, assumes b >= a
+void BigInt::subtractFromInPlace(std::string& a, const std::string& b) {
+    if (a.length() < b.length()) a.insert(0, b.length() - a.length(), '0');
+    
+    int borrow = 0;
+    for (size_t i = a.length(); i-- > 0;) {
+        int diff = (b[i] - '0') - (a[i] - '0') - borrow;
+        if (diff < 0) {
+            diff += 10;
+            borrow = 1;
+        } else {
+            borrow = 0;
+        }
+        a[i] = char('0' + diff);
+    }
+    
+    size_t pos = a.find_first_not_of('0');
+    if (pos == std::string::npos) a.assign(1, '0');
+    else if (pos > 0) a.erase(0, pos);
+}
+
+// a *= b on magnitudes, the product overwrites a's buffer
+void BigInt::multiplyInPlace(std::string& a, const std::string& b) {
+    int n = a.length(), m = b.length();
+    std::vector<int> result(n + m, 0);
+    
+    for (int i = n - 1; i >= 0; i--) {
+        for (int j = m - 1; j >= 0; j--) {
+            int mul = (a[i] - '0') * (b[j] - '0');
+            int p1 = i + j, p2 = i + j + 1;
+            int sum = mul + result[p2];
+            
+            result[p2] = sum % 10;
+            result[p1] += sum / 10;
+        }
+    }
+    
+    size_t start = 0;
+    while (start + 1 < result.size() && result[start] == 0) start++;
+    a.resize(result.size() - start);
+    for (size_t k = start; k < result.size(); k++) {
+        a[k - start] = char('0' + result[k]);
+    }
+}
+
+int BigInt::compareStrings(const std::string& a, const std::string& b) {
+    if (a.length() != b.length()) {
+        return a.length() > b.length() ? 1 : -1;
+    }
+    return a.compare(b);
+}
+
+std::pair<std::string, std::string> BigInt::divideStrings(const std::string& a, const std::string& b) {
+    if (b == "0") throw std::runtime_error("Division by zero");
+    
+    std::string quotient = "0";
+    std::string remainder = "0";
+    
+    for (char digit : a) {
+        remainder = remainder == "0" ? std::string(1, digit) : remainder + digit;
+        
+        // Remove leading zeros from remainder
+        size_t pos = remainder.find_first_not_of('0');
+        if (pos != std::string::npos) {
+            remainder = remainder.substr(pos);
+        } else {
+            remainder = "0";
+        }
+        
+        int count = 0;
+        while (compareStrings(remainder, b) >= 0) {
+            subtractInPlace(remainder, b);
+            count++;
+        }
+        quotient = quotient == "0" ? std::to_string(count) : quotient + std::to_string(count);
+    }
+    
+    if (quotient.empty()) quotient = "0";
+    size_t pos = quotient.find_first_not_of('0');
+    if (pos != std::string::npos) {
+        quotient = quotient.substr(pos);
+    } else {
+        quotient = "0";
+    }
+    
+    return {quotient, remainder};
+}
+
+// Adds a signed magnitude to this number in place
+BigInt& BigInt::addSigned(const std::string& mag, bool magNegative) {
+    if (&mag == &value) {
+        std::string copy = mag;
+        return addSigned(copy, magNegative);
+    }
+    
+    if (negative == magNegative) {
+        addInPlace(value, mag);
+    } else {
+        int cmp = compareStrings(value, mag);
+        if (cmp > 0) {
+            subtractInPlace(value, mag);
+        } else if (cmp < 0) {
+            subtractFromInPlace(value, mag);
+            negative = magNegative;
+        } else {
+            value.assign(1, '0');
+            negative = false;
+        }
+    }
+    
+    normalize();
+    return *this;
+}
+
+BigInt BigInt::operator+(const BigInt& other) const& {
+    return BigInt(*this) + other;
+}
+
+BigInt BigInt::operator+(const BigInt& other) && {
+    return std::move(addSigned(other.value, other.negative));
+}
+
+BigInt BigInt::operator-(const BigInt& other) const& {
+    return BigInt(*this) - other;
+}
+
+BigInt BigInt::operator-(const BigInt& other) && {
+    return std::move(addSigned(other.value, !other.negative));
+}
+
+BigInt BigInt::operator*(const BigInt& other) const& {
+    return BigInt(*this) * other;
+}
+
+BigInt BigInt::operator*(const BigInt& other) && {
+    bool productNegative = negative != other.negative;
+    multiplyInPlace(value, other.value);
+    negative = productNegative && value != "0";
+    return std::move(*this);
+}
+
+BigInt BigInt::operator/(const BigInt& other) const {
+    if (other.isZero()) throw std::runtime_error("Division by zero");
+    
+    // Floor division
+    auto [quot, rem] = divideStrings(value, other.value);
+    BigInt result(quot);
+    
+    // Python floor division behavior
+    // For different signs with non-zero remainder, we need -(q+1) instead of q
+    if (negative != other.negative) {
+        if (rem != "0") {
+            result = std::move(result) + BigInt(1);
+        }
+        result.negative = !result.isZero();
+    } else {
+        result.negative = false;
+    }
+    
+    result.normalize();
+    return result;
+}
+
+BigInt BigInt::operator%(const BigInt& other) const {
+    if (other.isZero()) throw std::runtime_error("Division by zero");
+    
+    // a % b = a - (a // b) * b
+    BigInt quotient = *this / other;
+    BigInt result = *this - (std::move(quotient) * other);
+    result.normalize();
+    return result;
+}
+
+BigInt BigInt::operator-() const& {
+    return -BigInt(*this);
+}
+
+BigInt BigInt::operator-() && {
+    if (!isZero()) {
+        negative = !negative;
+    }
+    return std::move(*this);
+}
+
+bool BigInt::operator<(const BigInt& other) const {
+    if (negative != other.negative) return negative;
+    if (negative) return compareStrings(value, other.value) > 0;
+    return compareStrings(value, other.value) < 0;
+}
+
+bool BigInt::operator>(const BigInt& other) const {
+    return other < *this;
+}
+
+bool BigInt::operator<=(const BigInt& other) const {
+    return !(*this > other);
+}
+
+bool BigInt::operator>=(const BigInt& other) const {
+    return !(*this < other);
+}
+
+bool BigInt::operator==(const BigInt& other) const {
+    return negative == other.negative && value == other.value;
+}
+
+bool BigInt::operator!=(const BigInt& other) const {
+    return !(*this == other);
+}
+
+std::string BigInt::toString() const {
+    return (negative ? "-" : "") + value;
+}
+
+void BigInt::appendTo(std::string& out) const {
+    if (negative) out += '-';
+    out += value;
+}
+
+double BigInt::toDouble() const {
+    double result = std::stod(value);
+    return negative ? -result : result;
+}
+
+bool BigInt::toLongLong(long long& out) const {
+    if (value.size() > 18) return false;
+    long long magnitude = 0;
+    for (char digit : value) magnitude = magnitude * 10 + (digit - '0');
+    out = negative ? -magnitude : magnitude;
+    return true;
+}
+
+bool BigInt::isZero() const {
+    return value == "0";
+}
+
+// Tuple Implementation
+Tuple::Tuple(size_t n) : refCount(1), count(n) {
+    if (n <= kInlineCapacity) {
+        items = reinterpret_cast<Value*>(inlineStorage);
+        for (size_t i = 0; i < n; i++) new (&items[i]) Value();
+    } else {
+        items = new Value[n];
+    }
+}
+
+Tuple::~Tuple() {
+    if (count <= kInlineCapacity) {
+        for (size_t i = 0; i < count; i++) items[i].~Value();
+    } else {
+        delete[] items;
+    }
+}
+
+TupleRef Tuple::make(size_t n) {
+    return TupleRef(new Tuple(n));
+}
+
+// Value Implementation
+void Value::appendFloat(std::string& out, double f) {
+    // Fixed notation with 6 decimals; the longest double is DBL_MAX_10_EXP + 1
+    // integral digits, so 400 bytes always suffice
+    char buf[400];
+    auto res = std::to_chars(buf, buf + sizeof(buf), f, std::chars_format::fixed, 6);
+    out.append(buf, res.ptr);
+}
+
+void Value::appendTo(std::string& out) const {
+    switch (type) {
+        case NONE: out += "None"; break;
+        case BOOL: out += boolVal ? "True" : "False"; break;
+        case INT: intVal.appendTo(out); break;
+        case FLOAT: appendFloat(out, floatVal); break;
+        case STRING: out += strVal; break;
+        case TUPLE: {
+            if (tupleVal.empty()) {
+                out += "()";
+                break;
+            }
+            out += '(';
+            for (size_t i = 0; i < tupleVal.size(); i++) {
+                if (i > 0) out += ", ";
+                if (tupleVal[i].type == STRING) {
+                    out += '\'';
+                    out += tupleVal[i].strVal;
+                    out += '\'';
+                } else {
+                    tupleVal[i].appendTo(out);
+                }
+            }
+            if (tupleVal.size() == 1) out += ',';
+            out += ')';
+            break;
+        }
+        default: break;
+    }
+}
+
+std::string Value::toString() const {
+    if (type == STRING) return strVal;
+    std::string result;
+    appendTo(result);
+    return result;
+}
+
+bool Value::toBool() const {
+    switch (type) {
+        case NONE: return false;
+        case BOOL: return boolVal;
+        case INT: return !intVal.isZero();
+        case FLOAT: return floatVal != 0.0;
+        case STRING: return !strVal.empty();
+        case TUPLE: return !tupleVal.empty();
+        default: return false;
+    }
+}
+
+double Value::toFloat() const {
+    switch (type) {
+        case BOOL: return boolVal ? 1.0 : 0.0;
+        case INT: return intVal.toDouble();
+        case FLOAT: return floatVal;
+        case STRING: return std::stod(strVal);
+        default: return 0.0;
+    }
+}
+
+BigInt Value::toInt() const {
+    switch (type) {
+        case BOOL: return BigInt(boolVal ? 1 : 0);
+        case INT: return intVal;
+        case FLOAT: return BigInt((long long)floatVal);
+        case STRING: return BigInt(strVal);
+        default: return BigInt(0);
+    }
+}
+
+Value Value::operator+(const Value& other) const& {
+    if (type == STRING || other.type == STRING) {
+        return Value(toString() + other.toString());
+    }
+    if (type == FLOAT || other.type == FLOAT) {
+        return Value(toFloat() + other.toFloat());
+    }
+    if (type == INT && other.type == INT) {
+        return Value(intVal + other.intVal);
+    }
+    return Value();
+}
+
+Value Value::operator+(const Value& other) && {
+    if (type == STRING) {
+        other.appendTo(strVal);
+        return std::move(*this);
+    }
+    if (type == INT && other.type == INT) {
+        intVal = std::move(intVal) + other.intVal;
+        return std::move(*this);
+    }
+    return static_cast<const Value&>(*this) + other;
+}
+
+Value Value::operator-(const Value& other) const& {
+    if (type == FLOAT || other.type == FLOAT) {
+        return Value(toFloat() - other.toFloat());
+    }
+    if (type == INT && other.type == INT) {
+        return Value(intVal - other.intVal);
+    }
+    return Value();
+}
+
+Value Value::operator-(const Value& other) && {
+    if (type == INT && other.type == INT) {
+        intVal = std::move(intVal) - other.intVal;
+        return std::move(*this);
+    }
+    return static_cast<const Value&>(*this) - other;
+}
+
+Value Value::operator*(const Value& other) const& {
+    if (type == STRING && other.type == INT) {
+        std::string result;
+        BigInt count = other.intVal;
+        if (count.isNegative() || count.isZero()) return Value("");
+        
+        // For large counts, be careful
+        long long n = count.toDouble();
+        for (long long i = 0; i < n; i++) {
+            result += strVal;
+        }
+        return Value(result);
+    }
+    if (type == INT && other.type == STRING) {
+        return other * (*this);
+    }
+    if (type == FLOAT || other.type == FLOAT) {
+        return Value(toFloat() * other.toFloat());
+    }
+    if (type == INT && other.type == INT) {
+        return Value(intVal * other.intVal);
+    }
+    return Value();
+}
+
+Value Value::operator*(const Value& other) && {
+    if (type == INT && other.type == INT) {
+        intVal = std::move(intVal) * other.intVal;
+        return std::move(*this);
+    }
+    return static_cast<const Value&>(*this) * other;
+}
+
+Value Value::operator/(const Value& other) const {
+    // Always float division
+    return Value(toFloat() / other.toFloat());
+}
+
+Value Value::floordiv(const Value& other) const {
+    if (type == INT && other.type == INT) {
+        return Value(intVal / other.intVal);
+    }
+    // For floats, use floor
+    double result = std::floor(toFloat() / other.toFloat());
+    return Value(BigInt((long long)result));
+}
+
+Value Value::operator%(const Value& other) const {
+    if (type == INT && other.type == INT) {
+        return Value(intVal % other.intVal);
+    }
+    // For floats, use fmod with Python semantics
+    double a = toFloat();
+    double b = other.toFloat();
+    double result = std::fmod(a, b);
+    if ((result < 0 && b > 0) || (result > 0 && b < 0)) {
+        result += b;
+    }
+    return Value(result);
+}
+
+Value Value::operator-() const& {
+    if (type == INT) return Value(-intVal);
+    if (type == FLOAT) return Value(-floatVal);
+    return Value();
+}
+
+Value Value::operator-() && {
+    if (type == INT) {
+        intVal = -std::move(intVal);
+        return std::move(*this);
+    }
+    return -static_cast<const Value&>(*this);
+}
+
+bool Value::operator<(const Value& other) const {
+    if (type == STRING && other.type == STRING) {
+        return strVal < other.strVal;
+    }
+    if (type == FLOAT || other.type == FLOAT) {
+        return toFloat() < other.toFloat();
+    }
+    if (type == INT && other.type == INT) {
+        return intVal < other.intVal;
+    }
+    return false;
+}
+
+bool Value::operator>(const Value& other) const {
+    return other < *this;
+}
+
+bool Value::operator<=(const Value& other) const {
+    return !(*this > other);
+}
+
+bool Value::operator>=(const Value& other) const {
+    return !(*this < other);
+}
+
+bool Value::operator==(const Value& other) const {
+    // Type conversions for ==
+    if (type == other.type) {
+        switch (type) {
+            case NONE: return true;
+            case BOOL: return boolVal == other.boolVal;
+            case INT: return intVal == other.intVal;
+            case FLOAT: return floatVal == other.floatVal;
+            case STRING: return strVal == other.strVal;
+            default: return false;
+        }
+    }
+    
+    // Cross-type comparisons (except STRING)
+    if (type == STRING || other.type == STRING) return false;
+    
+    if ((type == INT || type == FLOAT || type == BOOL) && 
+        (other.type == INT || other.type == FLOAT || other.type == BOOL)) {
+        if (type == FLOAT || other.type == FLOAT) {
+            return toFloat() == other.toFloat();
+        }
+        return toInt() == other.toInt();
+    }
+    
+    return false;
+}
+
+bool Value::operator!=(const Value& other) const {
+    return !(*this == other);
+}
@@ -0,0 +1,170 @@
+#pragma once
+#ifndef PYTHON_INTERPRETER_VALUE_H
+#define PYTHON_INTERPRETER_VALUE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// BigInteger class for arbitrary precision arithmetic
+class BigInt {
+private:
+    std::string value;
+    bool negative;
+    
+    void normalize();
+    BigInt& addSigned(const std::string& mag, bool magNegative);
+    static void addInPlace(std::string& a, const std::string& b);
+    static void subtractInPlace(std::string& a, const std::string& b);
+    static void subtractFromInPlace(std::string& a, const std::string& b);
+    static void multiplyInPlace(std::string& a, const std::string& b);
+    static std::pair<std::string, std::string> divideStrings(const std::string& a, const std::string& b);
+    static int compareStrings(const std::string& a, const std::string& b);
+
+public:
+    BigInt();
+    BigInt(const std::string& s);
+    BigInt(long long n);
+    BigInt(int n);
+    BigInt(const BigInt& other) = default;
+    BigInt(BigInt&& other) noexcept = default;
+    BigInt& operator=(const BigInt& other) = default;
+    BigInt& operator=(BigInt&& other) noexcept = default;
+    
+    // The && overloads reuse the left operand's digit buffer
+    BigInt operator+(const BigInt& other) const&;
+    BigInt operator+(const BigInt& other) &&;
+    BigInt operator-(const BigInt& other) const&;
+    BigInt operator-(const BigInt& other) &&;
+    BigInt operator*(const BigInt& other) const&;
+    BigInt operator*(const BigInt& other) &&;
+    BigInt operator/(const BigInt& other) const; // floor division
+    BigInt operator%(const BigInt& other) const;
+    BigInt operator-() const&;
+    BigInt operator-() &&;
+    
+    bool operator<(const BigInt& other) const;
+    bool operator>(const BigInt& other) const;
+    bool operator<=(const BigInt& other) const;
+    bool operator>=(const BigInt& other) const;
+    bool operator==(const BigInt& other) const;
+    bool operator!=(const BigInt& other) const;
+    
+    std::string toString() const;
+    void appendTo(std::string& out) const;
+    double toDouble() const;
+    bool toLongLong(long long& out) const;     // false unless it has at most 18 digits
+    bool isZero() const;
+    bool isNegative() const { return negative; }
+};
+
+class Value;
+class Tuple;
+
+// Reference-counted handle to an immutable Tuple
+class TupleRef {
+private:
+    Tuple* ptr;
+
+public:
+    TupleRef() : ptr(nullptr) {}
+    explicit TupleRef(Tuple* t) : ptr(t) {}
+    TupleRef(const TupleRef& other);
+    TupleRef(TupleRef&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+    TupleRef& operator=(TupleRef other) noexcept { std::swap(ptr, other.ptr); return *this; }
+    ~TupleRef();
+    
+    Tuple* get() const { return ptr; }
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    bool unique() const;
+    const Value& operator[](size_t i) const;
+};
+
+// Value class to hold different Python types
+class Value {
+public:
+    enum Type { NONE, BOOL, INT, FLOAT, STRING, TUPLE, FUNCTION };
+    
+    Type type;
+    bool boolVal;
+    BigInt intVal;
+    double floatVal;
+    std::string strVal;
+    TupleRef tupleVal;
+    
+    Value() : type(NONE) {}
+    Value(bool b) : type(BOOL), boolVal(b) {}
+    Value(const BigInt& i) : type(INT), intVal(i) {}
+    Value(int i) : type(INT), intVal(i) {}
+    Value(double f) : type(FLOAT), floatVal(f) {}
+    Value(const std::string& s) : type(STRING), strVal(s) {}
+    Value(TupleRef t) : type(TUPLE), tupleVal(std::move(t)) {}
+    
+    std::string toString() const;
+    void appendTo(std::string& out) const;
+    static void appendFloat(std::string& out, double f);
+    bool toBool() const;
+    double toFloat() const;
+    BigInt toInt() const;
+    
+    // The && overloads reuse the left operand's storage
+    Value operator+(const Value& other) const&;
+    Value operator+(const Value& other) &&;
+    Value operator-(const Value& other) const&;
+    Value operator-(const Value& other) &&;
+    Value operator*(const Value& other) const&;
+    Value operator*(const Value& other) &&;
+    Value operator/(const Value& other) const;
+    Value operator%(const Value& other) const;
+    Value floordiv(const Value& other) const;
+    Value operator-() const&;
+    Value operator-() &&;
+    
+    bool operator<(const Value& other) const;
+    bool operator>(const Value& other) const;
+    bool operator<=(const Value& other) const;
+    bool operator>=(const Value& other) const;
+    bool operator==(const Value& other) const;
+    bool operator!=(const Value& other) const;
+};
+
+// Immutable tuple; up to kInlineCapacity elements are stored inside the object
+class Tuple {
+public:
+    static constexpr size_t kInlineCapacity = 4;
+    
+    static TupleRef make(size_t n);
+    
+    size_t size() const { return count; }
+    Value& operator[](size_t i) { return items[i]; }
+    const Value& operator[](size_t i) const { return items[i]; }
+
+private:
+    size_t refCount;
+    size_t count;
+    Value* items;
+    alignas(Value) unsigned char inlineStorage[kInlineCapacity * sizeof(Value)];
+    
+    explicit Tuple(size_t n);
+    ~Tuple();
+    Tuple(const Tuple&) = delete;
+    Tuple& operator=(const Tuple&) = delete;
+    
+    friend class TupleRef;
+};
+
+inline TupleRef::TupleRef(const TupleRef& other) : ptr(other.ptr) {
+    if (ptr) ptr->refCount++;
+}
+
+inline TupleRef::~TupleRef() {
+    if (ptr && --ptr->refCount == 0) delete ptr;
+}
+
+inline size_t TupleRef::size() const { return ptr ? ptr->count : 0; }
+inline bool TupleRef::unique() const { return ptr && ptr->refCount == 1; }
+inline const Value& TupleRef::operator[](size_t i) const { return ptr->items[i]; }
+
+#endif//PYTHON_INTERPRETER_VALUE_H
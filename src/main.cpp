@@ -1,20 +1,78 @@
 #include "Evalvisitor.h"
+#include "Lowering.h"
+#include "Optimizer.h"
+#include "Interpreter.h"
+#include "Compiler.h"
+#include "CppEmitter.h"
+#include "Specializer.h"
+#include "VM.h"
 #include "Python3Lexer.h"
 #include "Python3Parser.h"
 #include "antlr4-runtime.h"
 #include <iostream>
+#include <string>
 using namespace antlr4;
 // TODO: regenerating files in directory named "generated" is dangerous.
 //       if you really need to regenerate,please ask TA for help.
 int main(int argc, const char *argv[]) {
+	// Programs run on the bytecode VM; --engine=ast walks the lowered AST and
+	// --engine=visitor the parse tree, which is useful for differential testing.
+	// --max-depth bounds the VM's call stack, --memoize caches the results
+	// of pure functions, up to N per function, and --jit compiles hot
+	// specialized functions to machine code. --emit-cpp prints the program as
+	// a C++ translation unit instead of running it
+	std::string engine = "vm";
+	size_t maxDepth = VM::kDefaultMaxDepth;
+	size_t memoCapacity = 0;
+	bool jit = false;
+	bool emitCpp = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--engine=vm" || arg == "--engine=ast" || arg == "--engine=visitor") {
+			engine = arg.substr(9);
+		} else if (arg.rfind("--max-depth=", 0) == 0 && arg.size() > 12 &&
+		           arg.find_first_not_of("0123456789", 12) == std::string::npos) {
+			maxDepth = std::stoull(arg.substr(12));
+		} else if (arg == "--memoize") {
+			memoCapacity = VM::kDefaultMemoCapacity;
+		} else if (arg.rfind("--memoize=", 0) == 0 && arg.size() > 10 &&
+		           arg.find_first_not_of("0123456789", 10) == std::string::npos) {
+			memoCapacity = std::stoull(arg.substr(10));
+		} else if (arg == "--jit") {
+			jit = true;
+		} else if (arg == "--emit-cpp") {
+			emitCpp = true;
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--engine=vm|ast|visitor] [--max-depth=N] [--memoize[=N]] [--jit] [--emit-cpp] < program" << std::endl;
+			return 1;
+		}
+	}
 	// TODO: please don't modify the code below the construction of ifs if you want to use visitor mode
+	std::ios::sync_with_stdio(false);
 	ANTLRInputStream input(std::cin);
 	Python3Lexer lexer(&input);
 	CommonTokenStream tokens(&lexer);
 	tokens.fill();
 	Python3Parser parser(&tokens);
-	tree::ParseTree *tree = parser.file_input();
-	EvalVisitor visitor;
-	visitor.visit(tree);
-	return 0;
+	Python3Parser::File_inputContext *tree = parser.file_input();
+	if (engine == "visitor") {
+		EvalVisitor visitor;
+		visitor.visit(tree);
+		return 0;
+	}
+	ast::Program program = Lowering().lower(tree);
+	Optimizer().optimize(program);
+	if (emitCpp) {
+		CppEmitter().emit(program, std::cout);
+		return 0;
+	}
+	if (engine == "ast") {
+		Interpreter interpreter;
+		interpreter.run(program);
+		return 0;
+	}
+	bytecode::Module module = Compiler().compile(program);
+	Specializer().specialize(module);
+	VM vm(maxDepth, memoCapacity, jit);
+	return vm.run(module) ? 0 : 1;
 }